@@ -1,17 +1,424 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include "async.h"
+#include "histogram.h"
+#include "traffic.h"
 
-int main(int, char *[]) {
-    std::size_t bulk = 5;
-    auto h = async::connect(bulk);
-    auto h2 = async::connect(bulk);
-    async::receive(h, "1", 1);
-    async::receive(h2, "1\n", 2);
-    async::receive(h, "\n2\n3\n4\n5\n6\n{\na\n", 15);
-    async::receive(h, "b\nc\nd\n}\n89\n", 11);
-    async::disconnect(h);
-    async::disconnect(h2);
+using namespace griha;
 
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+    size_t producers { 1 };
+    size_t connections { 1 };
+    size_t bulk { 5 };
+    double duration { 10 };     // seconds
+    double rate {};             // lines per second of all producers; zero means unlimited
+    size_t interval_ms { 1000 };
+    std::string replay;         // capture file; synthetic traffic is generated if it's empty
+    TrafficOptions traffic;
+    size_t pool {};             // zero keeps default size of pool
+    async::options_t connection;
+    async::disconnect_mode_t disconnect { async::disconnect_mode_t::wait };
+};
+
+void usage() {
+    std::cerr
+        << "usage: async_cli [options]" << std::endl
+        << "load:" << std::endl
+        << "  -p, --producers N       producer threads (1); producer i feeds connections i, i + N, ..." << std::endl
+        << "                          or connection i % M if there are fewer connections" << std::endl
+        << "  -c, --connections M     connections (1)" << std::endl
+        << "  -b, --bulk N            bulk size of connections (5)" << std::endl
+        << "  -t, --duration SECONDS  duration of load (10)" << std::endl
+        << "  -r, --rate LINES        lines per second of all producers, 0 is unlimited (0)" << std::endl
+        << "  -i, --interval MS       interval of reports (1000)" << std::endl
+        << "traffic:" << std::endl
+        << "  --replay FILE           replay capture file instead of synthetic traffic" << std::endl
+        << "  --line-length DIST      length of statements (uniform:4:32)" << std::endl
+        << "  --distinct N            statements are taken from N distinct ones, 0 is random (0)" << std::endl
+        << "  --block-ratio P         probability of explicit block in place of statement (0)" << std::endl
+        << "  --block-length DIST     statements of explicit block (uniform:1:10)" << std::endl
+        << "  --nesting P             probability of nested block inside block (0)" << std::endl
+        << "  --chunk BYTES           bytes passed to single receive (4096)" << std::endl
+        << "  --corpus BYTES          synthetic text generated per producer (4194304)" << std::endl
+        << "  --seed N                seed of synthetic traffic (1)" << std::endl
+        << "  DIST is N, fixed:N, uniform:A:B or exp:MEAN" << std::endl
+        << "library:" << std::endl
+        << "  --pool N                threads of pool" << std::endl
+        << "  --file-mode MODE        per_bulk, batched, uring, compressed or mapped (per_bulk)" << std::endl
+        << "  --no-log, --no-files    disable sink" << std::endl
+        << "  --queue-limit N         bulks per sink (256)" << std::endl
+        << "  --overflow MODE         block or drop (block)" << std::endl
+        << "  --cache N               statement cache of N entries per connection (0)" << std::endl
+        << "  --single-producer       skip locking of connections; requires producers <= connections" << std::endl
+        << "  --detach                detach disconnects" << std::endl
+        << "Reports go to stderr, so output of log may be redirected separately" << std::endl;
+}
+
+size_t to_size(const std::string& value) {
+    size_t end = 0;
+    size_t ret = 0;
+    try {
+        ret = std::stoull(value, &end);
+    } catch (const std::exception&) {
+        end = 0;
+    }
+    if (value.empty() || end != value.size() || value[0] == '-')
+        throw std::invalid_argument("invalid number: " + value);
+    return ret;
+}
+
+double to_double(const std::string& value) {
+    size_t end = 0;
+    double ret = 0;
+    try {
+        ret = std::stod(value, &end);
+    } catch (const std::exception&) {
+        end = 0;
+    }
+    if (value.empty() || end != value.size() || ret < 0)
+        throw std::invalid_argument("invalid number: " + value);
+    return ret;
+}
+
+double to_probability(const std::string& value) {
+    const auto ret = to_double(value);
+    if (ret > 1)
+        throw std::invalid_argument("invalid probability: " + value);
+    return ret;
+}
+
+async::file_mode_t to_file_mode(const std::string& value) {
+    if (value == "per_bulk") return async::file_mode_t::per_bulk;
+    if (value == "batched") return async::file_mode_t::batched;
+    if (value == "uring") return async::file_mode_t::uring;
+    if (value == "compressed") return async::file_mode_t::compressed;
+    if (value == "mapped") return async::file_mode_t::mapped;
+    throw std::invalid_argument("invalid file mode: " + value);
+}
+
+async::queue_overflow_t to_overflow(const std::string& value) {
+    if (value == "block") return async::queue_overflow_t::block;
+    if (value == "drop") return async::queue_overflow_t::drop;
+    throw std::invalid_argument("invalid overflow: " + value);
+}
+
+// returns false if usage is requested; throws std::exception on invalid arguments
+bool parse(int argc, char** argv, Options& options) {
+    for (auto i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        auto value = [&] () -> std::string {
+            if (i + 1 == argc)
+                throw std::invalid_argument(arg + " requires value");
+            return argv[++i];
+        };
+
+        auto& traffic = options.traffic;
+        auto& connection = options.connection;
+        if (arg == "-h" || arg == "--help") return false;
+        else if (arg == "-p" || arg == "--producers") options.producers = to_size(value());
+        else if (arg == "-c" || arg == "--connections") options.connections = to_size(value());
+        else if (arg == "-b" || arg == "--bulk") options.bulk = to_size(value());
+        else if (arg == "-t" || arg == "--duration") options.duration = to_double(value());
+        else if (arg == "-r" || arg == "--rate") options.rate = to_double(value());
+        else if (arg == "-i" || arg == "--interval") options.interval_ms = to_size(value());
+        else if (arg == "--replay") options.replay = value();
+        else if (arg == "--line-length") traffic.line_length = Distribution::parse(value());
+        else if (arg == "--distinct") traffic.distinct = to_size(value());
+        else if (arg == "--block-ratio") traffic.block_ratio = to_probability(value());
+        else if (arg == "--block-length") traffic.block_length = Distribution::parse(value());
+        else if (arg == "--nesting") traffic.nesting = to_probability(value());
+        else if (arg == "--chunk") traffic.chunk_bytes = to_size(value());
+        else if (arg == "--corpus") traffic.corpus_bytes = to_size(value());
+        else if (arg == "--seed") traffic.seed = to_size(value());
+        else if (arg == "--pool") options.pool = to_size(value());
+        else if (arg == "--file-mode") connection.file_mode = to_file_mode(value());
+        else if (arg == "--no-log") connection.log = false;
+        else if (arg == "--no-files") connection.files = false;
+        else if (arg == "--queue-limit") connection.queue_limit = to_size(value());
+        else if (arg == "--overflow") connection.queue_overflow = to_overflow(value());
+        else if (arg == "--cache") connection.statement_cache_size = to_size(value());
+        else if (arg == "--single-producer") connection.single_producer = true;
+        else if (arg == "--detach") options.disconnect = async::disconnect_mode_t::detach;
+        else throw std::invalid_argument("unknown option: " + arg);
+    }
+
+    if (options.producers == 0 || options.connections == 0 || options.bulk == 0
+            || options.interval_ms == 0 || options.traffic.chunk_bytes == 0)
+        throw std::invalid_argument("producers, connections, bulk, interval and chunk must be positive");
+    if (options.connection.single_producer && options.producers > options.connections)
+        throw std::invalid_argument("--single-producer requires producers <= connections");
+    return true;
+}
+
+struct Producer {
+    std::vector<async::handle_t> handles;
+    const Corpus* corpus {};
+    std::atomic<size_t> nlines {};
+    std::atomic<size_t> nbytes {};
+    Histogram latency; // nanoseconds of receive calls
+    std::thread thread;
+};
+
+void produce(Producer& producer, const Options& options, const std::atomic<bool>& stopped, size_t index) {
+    const auto& corpus = *producer.corpus;
+    const auto& chunks = corpus.chunks;
+    const auto rate = options.rate / options.producers;
+    const auto started = Clock::now();
+
+    // producers replaying the same corpus start at different chunks
+    auto next = index * chunks.size() / options.producers;
+    size_t nhandle = 0;
+    size_t nlines = 0;
+    while (!stopped.load(std::memory_order_relaxed)) {
+        auto& chunk = chunks[next++ % chunks.size()];
+        if (rate > 0) {
+            const auto due = started + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double> { nlines / rate });
+            std::this_thread::sleep_until(due);
+        }
+
+        const auto handle = producer.handles[nhandle++ % producer.handles.size()];
+        const auto data = corpus.data(chunk);
+        const auto start = Clock::now();
+        async::receive(handle, data.data(), data.size());
+        producer.latency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+
+        nlines += chunk.nlines;
+        producer.nlines.fetch_add(chunk.nlines, std::memory_order_relaxed);
+        producer.nbytes.fetch_add(chunk.size, std::memory_order_relaxed);
+    }
+}
+
+struct ProcessStats {
+    size_t rss_kb {};
+    size_t nthreads {};
+};
+
+ProcessStats read_process_stats() {
+    ProcessStats ret;
+    std::ifstream status { "/proc/self/status" };
+    for (std::string line; std::getline(status, line);) {
+        if (line.compare(0, 6, "VmRSS:") == 0)
+            ret.rss_kb = std::strtoull(line.c_str() + 6, nullptr, 10);
+        else if (line.compare(0, 8, "Threads:") == 0)
+            ret.nthreads = std::strtoull(line.c_str() + 8, nullptr, 10);
+    }
+    return ret;
+}
+
+// totals of producers at a moment
+struct Sample {
+    Clock::time_point time;
+    size_t nlines {};
+    size_t nbytes {};
+    size_t nblocks {};
+    Histogram::Snapshot latency;
+};
+
+Sample take_sample(const std::vector<std::unique_ptr<Producer>>& producers) {
+    Sample ret;
+    ret.time = Clock::now();
+    for (auto& p : producers) {
+        ret.nlines += p->nlines.load(std::memory_order_relaxed);
+        ret.nbytes += p->nbytes.load(std::memory_order_relaxed);
+        ret.latency += p->latency.snapshot();
+    }
+    return ret;
+}
+
+// histogram of values recorded between snapshots; maximum is the one of later snapshot
+Histogram::Snapshot difference(const Histogram::Snapshot& later, const Histogram::Snapshot& earlier) {
+    Histogram::Snapshot ret = later;
+    for (auto i = 0u; i < ret.counts.size(); ++i)
+        ret.counts[i] -= earlier.counts[i];
+    ret.count -= earlier.count;
+    return ret;
+}
+
+double to_us(uint64_t ns) {
+    return ns / 1000.;
+}
+
+const async::sink_metrics_t& written_by(const async::metrics_t& metrics, const Options& options) {
+    return options.connection.files || !options.connection.log ? metrics.files : metrics.log;
+}
+
+void print_header() {
+    std::cerr
+        << "time_s\tlines/s\tMB/s\tbulks/s"
+        << "\trecv_p50_us\trecv_p99_us\trecv_p999_us"
+        << "\twrite_p50_us\twrite_p99_us\twrite_p999_us"
+        << "\tdepth\tdropped\trss_mb\tthreads" << std::endl;
+}
+
+void print_interval(const Sample& from, const Sample& to, Clock::time_point started,
+                    const async::metrics_t& metrics, const Options& options, const ProcessStats& stats) {
+    const auto seconds = std::chrono::duration<double> { to.time - from.time }.count();
+    const auto latency = difference(to.latency, from.latency);
+    const auto& written = written_by(metrics, options);
+
+    std::cerr << std::fixed << std::setprecision(1)
+        << std::chrono::duration<double> { to.time - started }.count()
+        << '\t' << (to.nlines - from.nlines) / seconds
+        << '\t' << (to.nbytes - from.nbytes) / seconds / (1024 * 1024)
+        << '\t' << (to.nblocks - from.nblocks) / seconds
+        << '\t' << to_us(latency.percentile(.5))
+        << '\t' << to_us(latency.percentile(.99))
+        << '\t' << to_us(latency.percentile(.999))
+        // latencies of sinks are cumulative since they are taken from totals of library
+        << '\t' << to_us(written.latency.p50_ns)
+        << '\t' << to_us(written.latency.p99_ns)
+        << '\t' << to_us(written.latency.p999_ns)
+        << '\t' << metrics.log.queue_depth + metrics.files.queue_depth
+        << '\t' << metrics.log.dropped_blocks + metrics.files.dropped_blocks
+        << '\t' << stats.rss_kb / 1024.
+        << '\t' << stats.nthreads
+        << std::endl;
+}
+
+void print_latency(const char* name, const async::latency_t& latency) {
+    std::cerr << std::fixed << std::setprecision(1)
+        << "  " << name
+        << ": p50 " << to_us(latency.p50_ns)
+        << " us, p99 " << to_us(latency.p99_ns)
+        << " us, p999 " << to_us(latency.p999_ns)
+        << " us, max " << to_us(latency.max_ns) << " us" << std::endl;
+}
+
+int run(const Options& options) {
+    if (options.pool != 0)
+        async::set_pool_size(options.pool);
+
+    // synthetic corpora differ by producer, capture is shared
+    std::vector<Corpus> corpora;
+    if (!options.replay.empty()) {
+        corpora.push_back(Corpus::load(options.replay, options.traffic.chunk_bytes));
+    } else {
+        for (auto i = 0u; i < options.producers; ++i)
+            corpora.push_back(Corpus::generate(options.traffic, options.traffic.seed + i));
+    }
+
+    std::vector<async::handle_t> handles;
+    for (auto i = 0u; i < options.connections; ++i)
+        handles.push_back(async::connect(options.bulk, options.connection));
+
+    std::vector<std::unique_ptr<Producer>> producers;
+    for (auto i = 0u; i < options.producers; ++i) {
+        auto producer = std::make_unique<Producer>();
+        producer->corpus = &corpora[i % corpora.size()];
+        if (options.connections >= options.producers) {
+            for (auto c = i; c < options.connections; c += options.producers)
+                producer->handles.push_back(handles[c]);
+        } else {
+            producer->handles.push_back(handles[i % options.connections]);
+        }
+        producers.push_back(std::move(producer));
+    }
+
+    std::cerr << "producers " << options.producers << ", connections " << options.connections
+        << ", corpus " << corpora[0].text.size() << " bytes in " << corpora[0].chunks.size() << " chunks"
+        << ", threads before load " << read_process_stats().nthreads << std::endl;
+    print_header();
+
+    std::atomic<bool> stopped { false };
+    const auto started = Clock::now();
+    for (auto i = 0u; i < producers.size(); ++i)
+        producers[i]->thread = std::thread { [&, i] { produce(*producers[i], options, stopped, i); } };
+
+    const auto finish = started + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double> { options.duration });
+    const auto interval = std::chrono::milliseconds { options.interval_ms };
+    auto previous = take_sample(producers);
+    previous.time = started;
+    ProcessStats peak;
+    while (Clock::now() < finish) {
+        std::this_thread::sleep_until(std::min(finish, previous.time + interval));
+
+        auto sample = take_sample(producers);
+        const auto metrics = async::get_metrics();
+        const auto stats = read_process_stats();
+        sample.nblocks = metrics.blocks;
+        peak.rss_kb = std::max(peak.rss_kb, stats.rss_kb);
+        peak.nthreads = std::max(peak.nthreads, stats.nthreads);
+
+        print_interval(previous, sample, started, metrics, options, stats);
+        previous = std::move(sample);
+    }
+
+    stopped = true;
+    for (auto& producer : producers)
+        producer->thread.join();
+    const auto total = take_sample(producers);
+
+    // time of draining the rest of bulks
+    const auto disconnecting = Clock::now();
+    for (auto handle : handles)
+        async::disconnect(handle, options.disconnect);
+    async::flush_all();
+    const auto drained = Clock::now();
+
+    const auto metrics = async::get_metrics();
+    const auto seconds = std::chrono::duration<double> { total.time - started }.count();
+    std::cerr << std::fixed << std::setprecision(1)
+        << "total: " << total.nlines << " lines, " << total.nbytes << " bytes in " << seconds << " s; "
+        << total.nlines / seconds << " lines/s, " << total.nbytes / seconds / (1024 * 1024) << " MB/s" << std::endl
+        << "  bulks " << metrics.blocks << ", statements " << metrics.statements
+        << ", log bulks " << metrics.log.blocks << ", file bulks " << metrics.files.blocks
+        << ", dropped " << metrics.log.dropped_blocks + metrics.files.dropped_blocks << std::endl
+        << "  statement cache hits " << metrics.statement_cache_hits
+        << ", misses " << metrics.statement_cache_misses << std::endl;
+
+    async::latency_t receive {
+        total.latency.count,
+        total.latency.percentile(.5),
+        total.latency.percentile(.9),
+        total.latency.percentile(.99),
+        total.latency.percentile(.999),
+        total.latency.max
+    };
+    print_latency("receive", receive);
+    print_latency("close of bulk", metrics.close_latency);
+    print_latency("log", metrics.log.latency);
+    print_latency("files", metrics.files.latency);
+    std::cerr
+        << "  drained in " << std::chrono::duration<double, std::milli> { drained - disconnecting }.count() << " ms"
+        << ", peak rss " << peak.rss_kb / 1024. << " MB, peak threads " << peak.nthreads << std::endl;
     return 0;
 }
+
+} // unnamed namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    try {
+        if (!parse(argc, argv, options)) {
+            usage();
+            return 0;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "async_cli: " << e.what() << std::endl;
+        usage();
+        return 2;
+    }
+
+    try {
+        return run(options);
+    } catch (const std::exception& e) {
+        std::cerr << "async_cli: " << e.what() << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,165 @@
+#include "traffic.h"
+
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <stdexcept>
+
+namespace griha {
+
+namespace {
+
+constexpr auto c_max_nesting = 4u;
+
+double to_number(std::string_view value, std::string_view spec) {
+    const std::string text { value };
+    size_t end = 0;
+    double ret = 0;
+    try {
+        ret = std::stod(text, &end);
+    } catch (const std::exception&) {
+        end = 0;
+    }
+    if (text.empty() || end != text.size() || ret < 0)
+        throw std::invalid_argument("invalid distribution: " + std::string { spec });
+    return ret;
+}
+
+std::vector<std::string_view> split(std::string_view spec) {
+    std::vector<std::string_view> ret;
+    for (size_t pos = 0;;) {
+        const auto colon = spec.find(':', pos);
+        ret.push_back(spec.substr(pos, colon - pos));
+        if (colon == std::string_view::npos)
+            return ret;
+        pos = colon + 1;
+    }
+}
+
+std::string random_statement(std::mt19937_64& random, size_t length) {
+    static constexpr std::string_view c_alphabet = "abcdefghijklmnopqrstuvwxyz0123456789";
+    std::string ret(length, ' ');
+    for (auto& c : ret)
+        c = c_alphabet[random() % c_alphabet.size()];
+    return ret;
+}
+
+} // unnamed namespace
+
+Distribution Distribution::parse(std::string_view spec) {
+    const auto parts = split(spec);
+    if (parts.size() == 1)
+        return { Kind::fixed, to_number(parts[0], spec), 0 };
+    if (parts.size() == 2 && parts[0] == "fixed")
+        return { Kind::fixed, to_number(parts[1], spec), 0 };
+    if (parts.size() == 2 && parts[0] == "exp")
+        return { Kind::exponential, to_number(parts[1], spec), 0 };
+    if (parts.size() == 3 && parts[0] == "uniform") {
+        const auto a = to_number(parts[1], spec);
+        const auto b = to_number(parts[2], spec);
+        if (a <= b)
+            return { Kind::uniform, a, b };
+    }
+    throw std::invalid_argument("invalid distribution: " + std::string { spec });
+}
+
+size_t Distribution::operator() (std::mt19937_64& random, size_t minimum) const {
+    double value = a_;
+    switch (kind_) {
+        case Kind::fixed: break;
+        case Kind::uniform: value = std::uniform_real_distribution<> { a_, b_ + 1 }(random); break;
+        case Kind::exponential: value = a_ > 0 ? std::exponential_distribution<> { 1 / a_ }(random) : 0; break;
+    }
+    return std::max(minimum, static_cast<size_t>(value));
+}
+
+Corpus Corpus::generate(const TrafficOptions& options, uint64_t seed) {
+    std::mt19937_64 random { seed };
+    std::bernoulli_distribution in_block { options.block_ratio };
+    std::bernoulli_distribution nested { options.nesting };
+
+    std::vector<std::string> statements;
+    for (auto i = 0u; i < options.distinct; ++i)
+        statements.push_back(random_statement(random, options.line_length(random, 1)));
+
+    std::string unit;
+    size_t nlines = 0;
+    auto append_statement = [&] {
+        if (statements.empty())
+            unit += random_statement(random, options.line_length(random, 1));
+        else
+            unit += statements[random() % statements.size()];
+        unit.push_back('\n');
+        ++nlines;
+    };
+
+    std::function<void(unsigned)> append_block = [&] (unsigned depth) {
+        unit += "{\n";
+        for (auto n = options.block_length(random, 1); n != 0; --n) {
+            if (depth < c_max_nesting && nested(random))
+                append_block(depth + 1);
+            else
+                append_statement();
+        }
+        unit += "}\n";
+        nlines += 2;
+    };
+
+    Corpus ret;
+    Corpus::Chunk chunk {};
+    while (ret.text.size() < options.corpus_bytes) {
+        unit.clear();
+        nlines = 0;
+        if (in_block(random))
+            append_block(1);
+        else
+            append_statement();
+
+        // unit larger than chunk makes chunk of its own
+        if (chunk.size != 0 && chunk.size + unit.size() > options.chunk_bytes) {
+            ret.chunks.push_back(chunk);
+            chunk = { ret.text.size(), 0, 0 };
+        }
+        ret.text += unit;
+        chunk.size += unit.size();
+        chunk.nlines += nlines;
+        ret.nlines += nlines;
+    }
+    ret.chunks.push_back(chunk);
+    return ret;
+}
+
+Corpus Corpus::load(const std::string& path, size_t chunk_bytes) {
+    std::ifstream input { path, std::ios::binary };
+    if (!input)
+        throw std::runtime_error("can't open " + path);
+
+    Corpus ret;
+    ret.text.assign(std::istreambuf_iterator<char> { input }, std::istreambuf_iterator<char> {});
+    if (ret.text.empty())
+        throw std::runtime_error(path + " is empty");
+
+    // chunk is cut after its last complete line; line longer than chunk makes chunk of its own
+    const std::string_view text { ret.text };
+    for (size_t pos = 0; pos < text.size();) {
+        auto end = std::min(text.size(), pos + chunk_bytes);
+        if (end < text.size()) {
+            const auto last = text.rfind('\n', end - 1);
+            if (last != std::string_view::npos && last >= pos) {
+                end = last + 1;
+            } else {
+                const auto next = text.find('\n', end);
+                end = next == std::string_view::npos ? text.size() : next + 1;
+            }
+        }
+
+        const auto nlines = static_cast<size_t>(std::count(text.begin() + pos, text.begin() + end, '\n'));
+        ret.chunks.push_back({ pos, end - pos, nlines });
+        ret.nlines += nlines;
+        pos = end;
+    }
+    return ret;
+}
+
+} // namespace griha
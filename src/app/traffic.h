@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace griha {
+
+// Distribution of sizes parsed from "N" or "fixed:N", "uniform:A:B" and "exp:MEAN"
+class Distribution {
+
+public:
+    enum class Kind { fixed, uniform, exponential };
+
+public:
+    Distribution() = default;
+    Distribution(Kind kind, double a, double b) : kind_(kind), a_(a), b_(b) {}
+
+    // throws std::invalid_argument if spec is malformed
+    static Distribution parse(std::string_view spec);
+
+    // never returns less than minimum
+    size_t operator() (std::mt19937_64& random, size_t minimum = 0) const;
+
+private:
+    Kind kind_ { Kind::fixed };
+    double a_ {};
+    double b_ {};
+};
+
+// Shape of synthetic traffic
+struct TrafficOptions {
+    Distribution line_length { Distribution::Kind::uniform, 4, 32 };
+    size_t distinct {};         // number of distinct statements; zero means every statement is random
+    double block_ratio {};      // probability of explicit block in place of statement
+    Distribution block_length { Distribution::Kind::uniform, 1, 10 }; // statements of explicit block
+    double nesting {};          // probability of nested block in place of statement inside block
+    size_t chunk_bytes { 4096 };
+    size_t corpus_bytes { 4 * 1024 * 1024 };
+    uint64_t seed { 1 };
+};
+
+// Input of producer split into chunks passed to single receive each.
+// Chunks end at line boundaries; synthetic chunks also keep explicit blocks whole,
+// so chunks of producers sharing a connection may interleave
+struct Corpus {
+    // chunk is kept as offset, so corpus may be moved
+    struct Chunk {
+        size_t offset;
+        size_t size;
+        size_t nlines;
+    };
+
+    std::string text;
+    std::vector<Chunk> chunks;
+    size_t nlines {};
+
+    std::string_view data(const Chunk& chunk) const {
+        return std::string_view { text }.substr(chunk.offset, chunk.size);
+    }
+
+    static Corpus generate(const TrafficOptions& options, uint64_t seed);
+    // throws std::runtime_error if file can't be read or it's empty
+    static Corpus load(const std::string& path, size_t chunk_bytes);
+};
+
+} // namespace griha
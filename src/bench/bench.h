@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+#include "bulk.h"
+#include "file_sink.h"
+#include "statement.h"
+#include "statement_container.h"
+
+namespace griha::bench {
+
+// lines of fixed length looking like "statement-000042"; every block_every-th line
+// is replaced by explicit block of two statements if block_every isn't zero
+std::string make_input(size_t nlines, size_t line_length, size_t block_every = 0);
+
+// sink which only touches statements, so jobs of file worker cost nothing but dispatch
+struct NullFileSink : FileSink {
+    size_t write(std::string_view name, const Bulk& bulk, size_t index) override;
+    void flush() override {}
+};
+
+} // namespace griha::bench
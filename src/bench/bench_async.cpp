@@ -0,0 +1,83 @@
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "async.h"
+#include "bench.h"
+
+namespace {
+
+std::vector<async::handle_t> g_handles;
+
+// producers of benchmark threads feed range(0) connections round-robin,
+// so connections are shared by producers when there are fewer of them
+void BM_AsyncReceive(benchmark::State& state) {
+    static const auto input = griha::bench::make_input(16, 16, 8);
+
+    if (state.thread_index() == 0) {
+        async::options_t options;
+        options.file_mode = async::file_mode_t::batched;
+        for (auto i = 0; i < state.range(0); ++i)
+            g_handles.push_back(async::connect(5, options));
+    }
+
+    size_t next = state.thread_index();
+    for (auto _ : state) {
+        async::receive(g_handles[next % g_handles.size()], input.data(), input.size());
+        ++next;
+    }
+
+    if (state.thread_index() == 0) {
+        for (auto handle : g_handles)
+            async::disconnect(handle);
+        g_handles.clear();
+    }
+
+    state.SetBytesProcessed(state.iterations() * input.size());
+}
+BENCHMARK(BM_AsyncReceive)->Arg(1)->Arg(16)->ThreadRange(1, 8)->UseRealTime();
+
+// custom sink draining bulks instead of log and files, range(0) is its concurrency
+void BM_AsyncReceiveCustomSink(benchmark::State& state) {
+    static const auto input = griha::bench::make_input(16, 16, 8);
+
+    async::sink_t sink;
+    sink.write = [] (const async::bulk_t& bulk, std::size_t, void*) {
+        benchmark::DoNotOptimize(bulk.count);
+    };
+    sink.concurrency = state.range(0);
+
+    async::options_t options;
+    options.log = false;
+    options.files = false;
+    options.sinks = &sink;
+    options.nsinks = 1;
+    auto handle = async::connect(5, options);
+    for (auto _ : state)
+        async::receive(handle, input.data(), input.size());
+    async::disconnect(handle);
+
+    state.SetBytesProcessed(state.iterations() * input.size());
+}
+BENCHMARK(BM_AsyncReceiveCustomSink)->Arg(0)->Arg(1)->Arg(4)->UseRealTime();
+
+// churn of short connections; range(0) selects detached disconnect
+void BM_AsyncConnectDisconnect(benchmark::State& state) {
+    static const auto input = griha::bench::make_input(16, 16, 8);
+    const auto mode = state.range(0) ? async::disconnect_mode_t::detach : async::disconnect_mode_t::wait;
+
+    async::options_t options;
+    options.file_mode = async::file_mode_t::batched;
+    for (auto _ : state) {
+        auto handle = async::connect(5, options);
+        async::receive(handle, input.data(), input.size());
+        async::disconnect(handle, mode);
+    }
+    async::flush_all();
+
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_AsyncConnectDisconnect)->Arg(0)->Arg(1)->UseRealTime();
+
+} // unnamed namespace
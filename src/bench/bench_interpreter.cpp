@@ -0,0 +1,131 @@
+#include <iostream>
+#include <string_view>
+
+#include <benchmark/benchmark.h>
+
+#include "bench.h"
+#include "executor.h"
+#include "interpreter.h"
+
+using namespace griha;
+
+namespace {
+
+// line splitting of Interpreter::consume for input received in chunks of range(0) bytes;
+// bulks go to muted log and null file sink, so cost of sinks is minimal
+void BM_InterpreterConsume(benchmark::State& state) {
+    const auto chunk_size = static_cast<size_t>(state.range(0));
+    const auto input = bench::make_input(64 * 1024, 16);
+
+    std::ostream null_output { nullptr };
+    Executor executor { 2 };
+    bench::NullFileSink file_sink;
+    Interpreter::Context context { Logger { null_output }, executor, 5 };
+    context.file_sink = &file_sink;
+    Interpreter interpreter { context, "bench" };
+
+    std::string_view rest;
+    size_t nbytes = 0;
+    for (auto _ : state) {
+        if (rest.empty())
+            rest = input;
+
+        const auto chunk = rest.substr(0, chunk_size);
+        interpreter.consume(chunk);
+        rest.remove_prefix(chunk.size());
+        nbytes += chunk.size();
+    }
+    interpreter.stop_and_log_metrics();
+
+    state.SetBytesProcessed(nbytes);
+}
+BENCHMARK(BM_InterpreterConsume)->Arg(16)->Arg(256)->Arg(4096)->Arg(64 * 1024);
+
+// lines are carried between chunks and truncated to maximum line length
+void BM_InterpreterConsumeLongLines(benchmark::State& state) {
+    const auto input = bench::make_input(256, 4096);
+
+    std::ostream null_output { nullptr };
+    Executor executor { 2 };
+    bench::NullFileSink file_sink;
+    Interpreter::Context context { Logger { null_output }, executor, 5 };
+    context.file_sink = &file_sink;
+    context.max_line_length = 256;
+    Interpreter interpreter { context, "bench" };
+
+    std::string_view rest;
+    size_t nbytes = 0;
+    for (auto _ : state) {
+        if (rest.empty())
+            rest = input;
+
+        const auto chunk = rest.substr(0, 1000);
+        interpreter.consume(chunk);
+        rest.remove_prefix(chunk.size());
+        nbytes += chunk.size();
+    }
+    interpreter.stop_and_log_metrics();
+
+    state.SetBytesProcessed(nbytes);
+}
+BENCHMARK(BM_InterpreterConsumeLongLines);
+
+// bulks written into a file per bulk by default file job of range(0) pool threads;
+// producer is held back by queue limit, so it's throughput of file jobs
+void BM_InterpreterPerBulkFiles(benchmark::State& state) {
+    const auto input = bench::make_input(64 * 1024, 16);
+
+    std::ostream null_output { nullptr };
+    Executor executor { static_cast<size_t>(state.range(0)) };
+    Interpreter::Context context { Logger { null_output }, executor, 5 };
+    context.log = false;
+    Interpreter interpreter { context, "bench" };
+
+    std::string_view rest;
+    size_t nbytes = 0;
+    for (auto _ : state) {
+        if (rest.empty())
+            rest = input;
+
+        const auto chunk = rest.substr(0, 4096);
+        interpreter.consume(chunk);
+        rest.remove_prefix(chunk.size());
+        nbytes += chunk.size();
+    }
+    interpreter.stop_and_log_metrics();
+
+    state.SetBytesProcessed(nbytes);
+}
+BENCHMARK(BM_InterpreterPerBulkFiles)->Arg(1)->Arg(4)->UseRealTime();
+
+// log job alone formatting bulks for logger, which is asynchronous if range(0) isn't zero
+void BM_InterpreterLogOnly(benchmark::State& state) {
+    const auto input = bench::make_input(64 * 1024, 16);
+
+    std::ostream null_output { nullptr };
+    Executor executor { 2 };
+    Interpreter::Context context {
+        state.range(0) != 0 ? Logger { null_output, Logger::AsyncOptions {} } : Logger { null_output },
+        executor, 5
+    };
+    context.files = false;
+    Interpreter interpreter { context, "bench" };
+
+    std::string_view rest;
+    size_t nbytes = 0;
+    for (auto _ : state) {
+        if (rest.empty())
+            rest = input;
+
+        const auto chunk = rest.substr(0, 4096);
+        interpreter.consume(chunk);
+        rest.remove_prefix(chunk.size());
+        nbytes += chunk.size();
+    }
+    interpreter.stop_and_log_metrics();
+
+    state.SetBytesProcessed(nbytes);
+}
+BENCHMARK(BM_InterpreterLogOnly)->Arg(0)->Arg(1)->UseRealTime();
+
+} // unnamed namespace
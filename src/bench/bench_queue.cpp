@@ -0,0 +1,62 @@
+#include <atomic>
+#include <memory>
+#include <thread>
+
+#include <benchmark/benchmark.h>
+
+#include "executor.h"
+#include "mpmc_queue.h"
+
+using namespace griha;
+
+namespace {
+
+// uncontended handoff between push and pop of the same thread
+void BM_MpmcQueuePushPop(benchmark::State& state) {
+    MpmcQueue<std::shared_ptr<int>> queue { 256 };
+    auto value = std::make_shared<int>(42);
+    std::shared_ptr<int> out;
+    for (auto _ : state) {
+        queue.try_push(value);
+        queue.try_pop(out);
+        value = std::move(out);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_MpmcQueuePushPop);
+
+// every thread both produces and consumes, like tasks of file worker do
+void BM_MpmcQueueContended(benchmark::State& state) {
+    static MpmcQueue<std::shared_ptr<int>> queue { 256 };
+
+    auto value = std::make_shared<int>(state.thread_index());
+    std::shared_ptr<int> out;
+    for (auto _ : state) {
+        while (!queue.try_push(value))
+            std::this_thread::yield();
+        while (!queue.try_pop(out))
+            std::this_thread::yield();
+        value = std::move(out);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_MpmcQueueContended)->ThreadRange(1, 8)->UseRealTime();
+
+// tasks are posted in batches of range(0) and waited for, as worker tasks are
+void BM_ExecutorPost(benchmark::State& state) {
+    const auto batch = static_cast<size_t>(state.range(0));
+    Executor executor { 2 };
+    std::atomic<size_t> ndone { 0 };
+
+    for (auto _ : state) {
+        ndone.store(0, std::memory_order_relaxed);
+        for (size_t i = 0; i < batch; ++i)
+            executor.post([&ndone] (size_t) { ndone.fetch_add(1, std::memory_order_release); });
+        while (ndone.load(std::memory_order_acquire) != batch)
+            std::this_thread::yield();
+    }
+    state.SetItemsProcessed(state.iterations() * batch);
+}
+BENCHMARK(BM_ExecutorPost)->Arg(1)->Arg(64)->UseRealTime();
+
+} // unnamed namespace
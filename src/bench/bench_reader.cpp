@@ -0,0 +1,121 @@
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "bench.h"
+#include "bulk.h"
+#include "line_scanner.h"
+#include "reader.h"
+#include "reader_subscriber.h"
+#include "statement_container.h"
+#include "statement_factory.h"
+
+using namespace griha;
+using namespace std::string_view_literals;
+
+namespace {
+
+struct NullSubscriber : ReaderSubscriber {
+    void on_block(const BulkPtr& bulk) override {
+        benchmark::DoNotOptimize(bulk.get());
+    }
+};
+
+Reader make_reader(size_t block_size) {
+    Reader ret { block_size };
+    ret.subscribe(std::make_shared<NullSubscriber>());
+    return ret;
+}
+
+// dynamic blocks closed by block size
+void BM_ReaderDynamicBlocks(benchmark::State& state) {
+    auto reader = make_reader(state.range(0));
+    for (auto _ : state)
+        reader.consume("statement-000042"sv);
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ReaderDynamicBlocks)->Arg(1)->Arg(5)->Arg(64);
+
+// newlines and delimiters of the maximum window of lines of range(0) bytes
+void BM_LineIndexScan(benchmark::State& state) {
+    const auto length = static_cast<size_t>(state.range(0));
+    const auto lines = bench::make_input(LineIndex::c_max_size / (length + 1), length, 8);
+    const auto input = std::string_view { lines }.substr(0, LineIndex::c_max_size);
+
+    LineIndex index;
+    for (auto _ : state) {
+        index.scan(input);
+        benchmark::DoNotOptimize(index.size());
+    }
+    state.SetBytesProcessed(state.iterations() * input.size());
+}
+BENCHMARK(BM_LineIndexScan)->Arg(16)->Arg(256)->Arg(4096);
+
+// every explicit block costs two transitions of state
+void BM_ReaderExplicitBlocks(benchmark::State& state) {
+    auto reader = make_reader(5);
+    for (auto _ : state) {
+        reader.consume("{"sv);
+        reader.consume("a"sv);
+        reader.consume("}"sv);
+    }
+    state.SetItemsProcessed(state.iterations() * 3);
+}
+BENCHMARK(BM_ReaderExplicitBlocks);
+
+void BM_ReaderNestedBlocks(benchmark::State& state) {
+    auto reader = make_reader(5);
+    for (auto _ : state) {
+        reader.consume("{"sv);
+        reader.consume("{"sv);
+        reader.consume("a"sv);
+        reader.consume("}"sv);
+        reader.consume("}"sv);
+    }
+    state.SetItemsProcessed(state.iterations() * 5);
+}
+BENCHMARK(BM_ReaderNestedBlocks);
+
+// statements are created in arena of a block of range(0) statements
+void BM_StatementFactoryCreate(benchmark::State& state) {
+    const auto block_size = static_cast<size_t>(state.range(0));
+    const auto line = std::string(state.range(1), 'x');
+
+    StatementFactory factory;
+    StatementContainer statements;
+    for (auto _ : state) {
+        statements.push_back(factory.create(line, statements));
+        if (statements.size() == block_size)
+            statements.clear();
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * line.size());
+}
+BENCHMARK(BM_StatementFactoryCreate)->Args({ 5, 16 })->Args({ 5, 256 })->Args({ 256, 16 });
+
+// repeated statements of range(0) distinct ones interned by cache of range(1) entries
+void BM_StatementFactoryCreateCached(benchmark::State& state) {
+    std::vector<std::string> lines;
+    for (auto i = 0; i < state.range(0); ++i)
+        lines.push_back("command-" + std::to_string(i * 7919 % 100003));
+
+    StatementFactory::Options options;
+    options.capacity = state.range(1);
+    StatementFactory factory { options };
+    StatementContainer statements;
+    size_t next = 0;
+    for (auto _ : state) {
+        statements.push_back(factory.create(lines[next++ % lines.size()], statements));
+        if (statements.size() == 5)
+            statements.clear();
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["hit_rate"] = double(factory.nhits()) / std::max<uint64_t>(1, factory.nhits() + factory.nmisses());
+}
+BENCHMARK(BM_StatementFactoryCreateCached)->Args({ 256, 0 })->Args({ 256, 1024 })->Args({ 4096, 1024 });
+
+} // unnamed namespace
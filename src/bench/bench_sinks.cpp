@@ -0,0 +1,78 @@
+#include <iostream>
+#include <string>
+
+#include <benchmark/benchmark.h>
+
+#include "batched_file_sink.h"
+#include "bulk.h"
+#include "logger.h"
+#include "mmap_file_sink.h"
+#include "statement_container.h"
+#include "statement_factory.h"
+
+using namespace griha;
+
+namespace {
+
+StatementContainer make_statements(size_t nstatements, size_t length) {
+    StatementFactory factory;
+    StatementContainer ret;
+    for (size_t i = 0; i < nstatements; ++i)
+        ret.push_back(factory.create(std::string(length, 'a' + i % 26), ret));
+    return ret;
+}
+
+// log line of a bulk, as it's formatted by log job
+void BM_LoggerLog(benchmark::State& state) {
+    std::ostream null_output { nullptr };
+    Logger logger { null_output };
+    const std::string message = "[42] bulk: statement-1, statement-2, statement-3, statement-4, statement-5";
+    for (auto _ : state)
+        logger.log(message);
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_LoggerLog);
+
+void BM_AsyncLoggerLog(benchmark::State& state) {
+    static std::ostream null_output { nullptr };
+    static Logger logger { null_output, Logger::AsyncOptions {} };
+    const std::string message = "[42] bulk: statement-1, statement-2, statement-3, statement-4, statement-5";
+    for (auto _ : state)
+        logger.log(message);
+    if (state.thread_index() == 0)
+        logger.flush();
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_AsyncLoggerLog)->ThreadRange(1, 4)->UseRealTime();
+
+// bulk of range(0) statements of range(1) bytes appended to long-lived file
+void BM_BatchedFileSinkWrite(benchmark::State& state) {
+    const Bulk bulk { make_statements(state.range(0), state.range(1)), {}, 0 };
+
+    BatchedFileSink sink { 1, BatchedFileSink::Options {} };
+    size_t nbytes = 0;
+    for (auto _ : state)
+        nbytes += sink.write("bench", bulk, 0);
+    sink.flush();
+
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(nbytes);
+}
+BENCHMARK(BM_BatchedFileSinkWrite)->Args({ 5, 16 })->Args({ 64, 256 });
+
+// the same bulks copied into preallocated memory-mapped file
+void BM_MmapFileSinkWrite(benchmark::State& state) {
+    const Bulk bulk { make_statements(state.range(0), state.range(1)), {}, 0 };
+
+    MmapFileSink sink { 1, MmapFileSink::Options {} };
+    size_t nbytes = 0;
+    for (auto _ : state)
+        nbytes += sink.write("bench", bulk, 0);
+    sink.flush();
+
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(nbytes);
+}
+BENCHMARK(BM_MmapFileSinkWrite)->Args({ 5, 16 })->Args({ 64, 256 });
+
+} // unnamed namespace
@@ -0,0 +1,82 @@
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include <dirent.h>
+#include <unistd.h>
+
+#include <benchmark/benchmark.h>
+
+#include "bench.h"
+
+namespace griha::bench {
+
+std::string make_input(size_t nlines, size_t line_length, size_t block_every) {
+    std::string ret;
+    ret.reserve(nlines * (line_length + 1));
+    for (size_t i = 0; i < nlines; ++i) {
+        if (block_every != 0 && i % block_every == block_every - 1) {
+            ret.append("{\na\nb\n}\n");
+            continue;
+        }
+
+        auto line = "statement-" + std::to_string(i);
+        line.resize(line_length, '.');
+        ret.append(line).push_back('\n');
+    }
+    return ret;
+}
+
+size_t NullFileSink::write(std::string_view, const Bulk& bulk, size_t) {
+    size_t ret = 0;
+    for (auto& stm : bulk.statements)
+        ret += std::visit([] (const SomeStatement& s) { return s.value().size(); }, stm);
+    benchmark::DoNotOptimize(ret);
+    return ret;
+}
+
+} // namespace griha::bench
+
+namespace {
+
+void remove_dir(const std::string& path) {
+    if (auto dir = opendir(path.c_str())) {
+        while (auto entry = readdir(dir)) {
+            const std::string name = entry->d_name;
+            if (name != "." && name != "..")
+                unlink((path + '/' + name).c_str());
+        }
+        closedir(dir);
+    }
+    rmdir(path.c_str());
+}
+
+} // unnamed namespace
+
+// Sinks produce bulk files, so benchmarks are run in temporary directory removed afterwards.
+// Log of connections goes to std::cout, it's muted and report is printed to the original stream
+int main(int argc, char** argv) {
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+        return 1;
+
+    char dir[] = "/tmp/async_bench.XXXXXX";
+    if (mkdtemp(dir) == nullptr || chdir(dir) != 0) {
+        std::perror("async_bench");
+        return 1;
+    }
+
+    std::ostream report { std::cout.rdbuf() };
+    std::cout.rdbuf(nullptr);
+
+    benchmark::ConsoleReporter reporter;
+    reporter.SetOutputStream(&report);
+    reporter.SetErrorStream(&std::cerr);
+    benchmark::RunSpecifiedBenchmarks(&reporter);
+    benchmark::Shutdown();
+
+    if (chdir("/") == 0)
+        remove_dir(dir);
+    return 0;
+}
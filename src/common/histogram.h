@@ -0,0 +1,97 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+namespace griha {
+
+// Log-linear histogram of non-negative values, e.g. latencies in nanoseconds.
+// Every power of two range is split into c_sub_buckets linear buckets, so relative error
+// of percentiles is below 1/c_sub_buckets. Recording is lock-free and may be done by many threads.
+// It's header-only, so it's shared by the library and its tools without exporting internals
+class Histogram {
+
+    static constexpr unsigned c_sub_bits = 3;
+    static constexpr size_t c_sub_buckets = size_t { 1 } << c_sub_bits;
+
+public:
+    static constexpr size_t c_nbuckets = (64 - c_sub_bits + 1) * c_sub_buckets;
+
+    struct Snapshot {
+        std::array<uint64_t, c_nbuckets> counts {};
+        uint64_t count {};
+        uint64_t max {};
+
+        Snapshot& operator+= (const Snapshot& other) {
+            for (auto i = 0u; i < c_nbuckets; ++i)
+                counts[i] += other.counts[i];
+            count += other.count;
+            max = std::max(max, other.max);
+            return *this;
+        }
+
+        // q is in [0, 1]; returns upper bound of bucket containing the percentile
+        uint64_t percentile(double q) const {
+            if (count == 0)
+                return 0;
+
+            const auto rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(std::clamp(q, 0., 1.) * count)));
+            uint64_t seen = 0;
+            for (auto i = 0u; i < c_nbuckets; ++i) {
+                seen += counts[i];
+                if (seen >= rank)
+                    return i + 1 < c_nbuckets ? std::min(lower_bound(i + 1) - 1, max) : max;
+            }
+            return max;
+        }
+    };
+
+public:
+    Histogram() = default;
+
+    Histogram(const Histogram&) = delete;
+    Histogram& operator= (const Histogram&) = delete;
+
+    void record(uint64_t value) {
+        counts_[bucket_of(value)].fetch_add(1, std::memory_order_relaxed);
+        auto max = max_.load(std::memory_order_relaxed);
+        while (value > max && !max_.compare_exchange_weak(max, value, std::memory_order_relaxed)) {}
+    }
+
+    Snapshot snapshot() const {
+        Snapshot ret;
+        for (auto i = 0u; i < c_nbuckets; ++i) {
+            ret.counts[i] = counts_[i].load(std::memory_order_relaxed);
+            ret.count += ret.counts[i];
+        }
+        ret.max = max_.load(std::memory_order_relaxed);
+        return ret;
+    }
+
+    static size_t bucket_of(uint64_t value) {
+        if (value < c_sub_buckets)
+            return value;
+
+        const unsigned msb = 63 - __builtin_clzll(value);
+        const auto shift = msb - c_sub_bits;
+        return (shift + 1) * c_sub_buckets + ((value >> shift) & (c_sub_buckets - 1));
+    }
+
+    static uint64_t lower_bound(size_t bucket) {
+        if (bucket < c_sub_buckets)
+            return bucket;
+
+        const auto shift = bucket / c_sub_buckets - 1;
+        return (c_sub_buckets + bucket % c_sub_buckets) << shift;
+    }
+
+private:
+    std::array<std::atomic<uint64_t>, c_nbuckets> counts_ {};
+    std::atomic<uint64_t> max_ {};
+};
+
+} // namespace griha
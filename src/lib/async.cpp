@@ -1,62 +1,507 @@
 #include "async.h"
 
+#include <atomic>
+#include <condition_variable>
 #include <mutex>
-#include <future>
-#include <map>
+#include <thread>
+#include <utility>
 
+#include "executor.h"
+#include "batched_file_sink.h"
+#include "bulk.h"
+#include "handle_table.h"
 #include "interpreter.h"
 #include "logger.h"
+#include "mmap_file_sink.h"
+#include "statement.h"
+#include "statement_container.h"
+#include "timer_wheel.h"
+#ifdef ASYNC_WITH_IO_URING
+#include "uring_file_sink.h"
+#endif
+#ifdef ASYNC_WITH_ZSTD
+#include "segment_file_sink.h"
+#endif
 
 using namespace griha;
 
 namespace async {
 
-constexpr auto nthreads_per_connection = 2u;
+// granularity and size of timer wheel checking age of bulks
+constexpr auto c_timer_tick = std::chrono::milliseconds { 5 };
+constexpr auto c_timer_slots = 256u;
 
 struct ConnectionsHandler {
     Logger logger;
-    uintptr_t next_id {};
-    std::map<uintptr_t, InterpreterPtr> connections;
+    size_t pool_size { std::thread::hardware_concurrency() };
+    Executor::Affinity pool_affinity;
+    BatchedFileSink::Options file_sink_options;
+    // created along with executor since it keeps a file per executor thread;
+    // it must outlive executor which completes pending jobs on destruction
+    std::unique_ptr<BatchedFileSink> batched_file_sink;
+    std::unique_ptr<FileSink> uring_file_sink; // nullptr if io_uring is unavailable
+    compressed_files_t compressed_files;
+    std::unique_ptr<FileSink> segment_file_sink; // nullptr if zstd isn't built in
+    MmapFileSink::Options mapped_files;
+    std::unique_ptr<MmapFileSink> mmap_file_sink;
+    // created with the first connection limiting age of bulks or writing buffered files;
+    // it must outlive connections since they are called back by it
+    std::unique_ptr<TimerWheel> timers;
+    // periodic check of intervals of file sinks, changed under guard
+    TimerWheel::Timer flush_timer;
+    bool stopping { false };
+    // executor must outlive connections because of pending jobs
+    std::unique_ptr<Executor> executor;
+    std::atomic<uintptr_t> next_id {};
+    HandleTable<Interpreter> connections;
     std::mutex guard;
+    Interpreter::Metrics disconnected {}; // totals of disconnected connections, changed under guard
+    size_t ndetached {}; // detached disconnects in progress, changed under guard
+    std::condition_variable cv_detached;
+
+    // detached connections use guard and executor until they are finished;
+    // flush timer posts to executor, so it's cancelled before executor is destroyed
+    ~ConnectionsHandler() {
+        std::unique_lock l { guard };
+        cv_detached.wait(l, [this] { return ndetached == 0; });
+        stopping = true;
+        const auto timer = std::exchange(flush_timer, {});
+        l.unlock();
+
+        if (timer)
+            timers->cancel(timer);
+    }
 };
 ConnectionsHandler g_conn_handler;
 
+void set_pool_size(std::size_t nthreads) {
+    std::lock_guard l { g_conn_handler.guard };
+    g_conn_handler.pool_size = nthreads;
+}
+
+void set_pool_affinity(affinity_t kind, const int *ids, std::size_t count) {
+    std::lock_guard l { g_conn_handler.guard };
+    auto& affinity = g_conn_handler.pool_affinity;
+    affinity.kind = kind == affinity_t::nodes ? Executor::Affinity::Kind::nodes : Executor::Affinity::Kind::cores;
+    affinity.ids.assign(ids, ids + count);
+}
+
+void set_batched_files(const batched_files_t& settings) {
+    std::lock_guard l { g_conn_handler.guard };
+    auto& options = g_conn_handler.file_sink_options;
+    options.flush_bytes = settings.flush_bytes;
+    options.flush_interval = std::chrono::milliseconds { settings.flush_interval_ms };
+    options.rotate_bytes = settings.rotate_bytes;
+}
+
+void set_compressed_files(const compressed_files_t& settings) {
+    std::lock_guard l { g_conn_handler.guard };
+    g_conn_handler.compressed_files = settings;
+}
+
+void set_mapped_files(const mapped_files_t& settings) {
+    std::lock_guard l { g_conn_handler.guard };
+    auto& options = g_conn_handler.mapped_files;
+    options.segment_bytes = settings.segment_bytes;
+    options.sync_bytes = settings.sync_bytes;
+    options.sync_interval = std::chrono::milliseconds { settings.sync_interval_ms };
+}
+
+void set_async_logger(std::size_t flush_interval_ms) {
+    std::lock_guard l { g_conn_handler.guard };
+    if (g_conn_handler.executor)
+        return; // connections already share current logger
+
+    Logger::AsyncOptions options;
+    options.flush_interval = std::chrono::milliseconds { flush_interval_ms };
+    g_conn_handler.logger = Logger { std::cout, options };
+}
+
+// adapts custom sink of user to sinks of interpreter
+struct CallbackSink : FileSink {
+    sink_t sink;
+
+    explicit CallbackSink(const sink_t& s) : sink(s) {}
+
+    size_t write(std::string_view name, const Bulk& bulk, size_t index) override {
+        // keeps its capacity between bulks, so writing doesn't allocate in steady state
+        thread_local std::vector<iovec> statements;
+        statements.clear();
+
+        size_t nbytes = 0;
+        for (auto& stm : bulk.statements)
+            std::visit([&] (const SomeStatement& s) {
+                auto value = s.value();
+                statements.push_back({ const_cast<char*>(value.data()), value.size() });
+                nbytes += value.size();
+            }, stm);
+
+        sink.write(bulk_t { name.data(), name.size(), bulk.seq, statements.data(), statements.size() },
+            index, sink.context);
+        return nbytes;
+    }
+
+    void flush() override {
+        if (sink.flush)
+            sink.flush(sink.context);
+    }
+};
+
 handle_t connect(std::size_t bulk) {
-    Interpreter::Context context { g_conn_handler.logger, bulk, nthreads_per_connection };
+    return connect(bulk, options_t {});
+}
+
+Interpreter::QueueOverflow to_queue_overflow(queue_overflow_t overflow) {
+    switch (overflow) {
+        case queue_overflow_t::block: return Interpreter::QueueOverflow::block;
+        case queue_overflow_t::drop: return Interpreter::QueueOverflow::drop;
+        case queue_overflow_t::error: return Interpreter::QueueOverflow::error;
+    }
+    return Interpreter::QueueOverflow::block;
+}
+
+// the shortest interval of file sinks; zero if they don't flush by time
+std::chrono::milliseconds flush_period() {
+    const std::chrono::milliseconds intervals[] = {
+        g_conn_handler.file_sink_options.flush_interval,
+        std::chrono::milliseconds { g_conn_handler.compressed_files.flush_interval_ms },
+        g_conn_handler.mapped_files.sync_interval
+    };
+
+    std::chrono::milliseconds ret {};
+    for (auto interval : intervals)
+        if (interval.count() != 0 && (ret.count() == 0 || interval < ret))
+            ret = interval;
+    return ret;
+}
+
+void on_flush_timer();
+
+// file sinks check their intervals only when a thread writes, so data of threads
+// which have become idle is written out by timer; must be called under guard
+void schedule_flush_timer() {
+    const auto period = flush_period();
+    if (g_conn_handler.flush_timer || g_conn_handler.stopping || period.count() == 0)
+        return;
+
+    if (!g_conn_handler.timers)
+        g_conn_handler.timers = std::make_unique<TimerWheel>(c_timer_tick, c_timer_slots);
+    g_conn_handler.flush_timer = g_conn_handler.timers->schedule(TimerWheel::Clock::now() + period, on_flush_timer);
+}
+
+// writing is done by pool thread, since callbacks of timer wheel are expected to be short
+void on_flush_timer() {
+    g_conn_handler.executor->post([] (size_t) {
+        FileSink* sinks[] = {
+            g_conn_handler.batched_file_sink.get(),
+            g_conn_handler.segment_file_sink.get(),
+            g_conn_handler.mmap_file_sink.get()
+        };
+        for (auto sink : sinks)
+            if (sink != nullptr)
+                sink->flush_expired();
+    });
 
     std::lock_guard l { g_conn_handler.guard };
-    uintptr_t id = g_conn_handler.next_id++;
-    g_conn_handler.connections.emplace(id, std::make_shared<Interpreter>(context, std::to_string(id)));
-    return reinterpret_cast<handle_t>(id);
+    g_conn_handler.flush_timer = {};
+    schedule_flush_timer();
 }
 
-void receive(handle_t handle, const char *data, std::size_t size) {
-    auto id = reinterpret_cast<uintptr_t>(handle);
+// must be called under guard of connections handler
+Interpreter::Context make_context(std::size_t bulk, const options_t& options) {
+    if (!g_conn_handler.executor) {
+        g_conn_handler.executor = std::make_unique<Executor>(g_conn_handler.pool_size, g_conn_handler.pool_affinity);
+        g_conn_handler.batched_file_sink = std::make_unique<BatchedFileSink>(
+            g_conn_handler.executor->size(), g_conn_handler.file_sink_options);
+        g_conn_handler.mmap_file_sink = std::make_unique<MmapFileSink>(
+            g_conn_handler.executor->size(), g_conn_handler.mapped_files);
+#ifdef ASYNC_WITH_IO_URING
+        g_conn_handler.uring_file_sink = UringFileSink::create(g_conn_handler.executor->size());
+#endif
+#ifdef ASYNC_WITH_ZSTD
+        SegmentFileSink::Options segment_options;
+        segment_options.block_bytes = g_conn_handler.compressed_files.block_bytes;
+        segment_options.flush_interval = std::chrono::milliseconds { g_conn_handler.compressed_files.flush_interval_ms };
+        segment_options.segment_bytes = g_conn_handler.compressed_files.segment_bytes;
+        segment_options.level = g_conn_handler.compressed_files.level;
+        g_conn_handler.segment_file_sink = std::make_unique<SegmentFileSink>(
+            g_conn_handler.executor->size(), segment_options);
+#endif
+    }
 
-    InterpreterPtr intrp;
-    {
-        std::lock_guard l { g_conn_handler.guard };
-        if (g_conn_handler.connections.count(id) == 0)
-            return;
-        intrp = g_conn_handler.connections[id];
+    Interpreter::Context context { g_conn_handler.logger, *g_conn_handler.executor, bulk };
+    context.max_line_length = options.max_line_length;
+    context.line_overflow = options.line_overflow == line_overflow_t::skip
+        ? Interpreter::LineOverflow::skip
+        : Interpreter::LineOverflow::truncate;
+
+    context.queue_limit = options.queue_limit;
+    context.queue_overflow = to_queue_overflow(options.queue_overflow);
+
+    switch (options.file_mode) {
+        case file_mode_t::per_bulk: break;
+        case file_mode_t::batched: context.file_sink = g_conn_handler.batched_file_sink.get(); break;
+        case file_mode_t::uring: context.file_sink = g_conn_handler.uring_file_sink.get(); break;
+        case file_mode_t::compressed: context.file_sink = g_conn_handler.segment_file_sink.get(); break;
+        case file_mode_t::mapped: context.file_sink = g_conn_handler.mmap_file_sink.get(); break;
     }
+    if (options.files && context.file_sink != nullptr && options.file_mode != file_mode_t::uring)
+        schedule_flush_timer();
 
-    intrp->consume(std::string_view { data, size });
+    context.log = options.log;
+    context.files = options.files;
+    for (auto i = 0u; i < options.nsinks; ++i) {
+        const auto& sink = options.sinks[i];
+        Interpreter::SinkOptions sink_options;
+        sink_options.sink = std::make_shared<CallbackSink>(sink);
+        sink_options.concurrency = sink.concurrency;
+        sink_options.batch = sink.batch;
+        sink_options.queue_limit = sink.queue_limit;
+        sink_options.queue_overflow = to_queue_overflow(sink.queue_overflow);
+        context.sinks.push_back(std::move(sink_options));
+    }
+
+    context.single_producer = options.single_producer;
+    context.bulk_limits.max_bulk_bytes = options.max_bulk_bytes;
+    context.bulk_limits.max_bulk_age = std::chrono::milliseconds { options.max_bulk_age_ms };
+    context.statement_cache.capacity = options.statement_cache_size;
+    context.statement_cache.max_length = options.statement_cache_length;
+    context.statement_cache.eviction = options.statement_cache_eviction == cache_eviction_t::clear
+        ? StatementFactory::Eviction::clear
+        : StatementFactory::Eviction::generations;
+    if (options.max_bulk_age_ms != 0) {
+        if (!g_conn_handler.timers)
+            g_conn_handler.timers = std::make_unique<TimerWheel>(c_timer_tick, c_timer_slots);
+        context.timers = g_conn_handler.timers.get();
+    }
+
+    return context;
+}
+
+handle_t connect(std::size_t bulk, const options_t& options) {
+    auto context = [&] {
+        std::lock_guard l { g_conn_handler.guard };
+        return make_context(bulk, options);
+    }();
+
+    auto id = g_conn_handler.next_id++;
+    auto handle = g_conn_handler.connections.insert(std::make_unique<Interpreter>(context, std::to_string(id)));
+    return reinterpret_cast<handle_t>(handle);
+}
+
+void receive(handle_t handle, const char *data, std::size_t size) {
+    g_conn_handler.connections.visit(reinterpret_cast<uintptr_t>(handle), [data, size] (Interpreter& intrp) {
+        intrp.consume(std::string_view { data, size });
+    });
+}
+
+result_t try_receive(handle_t handle, const char *data, std::size_t size) {
+    auto accepted = true;
+    auto found = g_conn_handler.connections.visit(reinterpret_cast<uintptr_t>(handle), [&] (Interpreter& intrp) {
+        accepted = intrp.consume(std::string_view { data, size });
+    });
+
+    if (!found)
+        return result_t::invalid_handle;
+    return accepted ? result_t::ok : result_t::queue_full;
+}
+
+void receive_many(const handle_t *handles, const iovec *buffers, std::size_t count) {
+    for (std::size_t first = 0, last = 0; first < count; first = last) {
+        // run of entries addressed to the same connection is resolved once
+        while (++last < count && handles[last] == handles[first]);
+
+        g_conn_handler.connections.visit(reinterpret_cast<uintptr_t>(handles[first]), [&] (Interpreter& intrp) {
+            intrp.consume(buffers + first, last - first);
+        });
+    }
 }
 
 void disconnect(handle_t handle) {
-    auto id = reinterpret_cast<uintptr_t>(handle);
-    
-    InterpreterPtr intrp;
-    {
+    disconnect(handle, disconnect_mode_t::wait);
+}
+
+bool in_pool() {
+    std::lock_guard l { g_conn_handler.guard };
+    return g_conn_handler.executor && g_conn_handler.executor->in_pool();
+}
+
+void count_detached() {
+    std::lock_guard l { g_conn_handler.guard };
+    ++g_conn_handler.ndetached;
+}
+
+// the rest of disconnect is done by pool threads; it must have been counted by count_detached
+void detach(std::shared_ptr<Interpreter> intrp) {
+    // callback keeps interpreter alive; it's destroyed by pool thread along with callback
+    intrp->stop_and_log_metrics([intrp] {
+        const auto metrics = intrp->get_metrics();
+        // notified under guard, since handler may be destroyed as soon as it's woken up
         std::lock_guard l { g_conn_handler.guard };
-        if (g_conn_handler.connections.count(id) == 0)
-            return;
-        intrp = g_conn_handler.connections[id];
-        g_conn_handler.connections.erase(id);
+        g_conn_handler.disconnected += metrics;
+        if (--g_conn_handler.ndetached == 0)
+            g_conn_handler.cv_detached.notify_all();
+    });
+}
+
+void disconnect(handle_t handle, disconnect_mode_t mode) {
+    const auto key = reinterpret_cast<uintptr_t>(handle);
+
+    // pool thread, e.g. running flush callback, can't wait for tasks which may be queued behind it,
+    // nor for producers of the connection blocked by them; connection is detached once producers leave
+    if (in_pool()) {
+        count_detached();
+        const auto removed = g_conn_handler.connections.remove(key, [] (std::unique_ptr<Interpreter> intrp) {
+            detach(std::move(intrp));
+        });
+        if (!removed) {
+            std::lock_guard l { g_conn_handler.guard };
+            if (--g_conn_handler.ndetached == 0)
+                g_conn_handler.cv_detached.notify_all();
+        }
+        return;
+    }
+
+    std::shared_ptr<Interpreter> intrp = g_conn_handler.connections.remove(key);
+    if (!intrp)
+        return;
+
+    if (mode == disconnect_mode_t::detach) {
+        count_detached();
+        detach(std::move(intrp));
+        return;
     }
 
     intrp->stop_and_log_metrics();
+
+    const auto metrics = intrp->get_metrics();
+    std::lock_guard l { g_conn_handler.guard };
+    g_conn_handler.disconnected += metrics;
+}
+
+void flush_all() {
+    struct Pending {
+        std::mutex guard;
+        std::condition_variable cv;
+        size_t count {};
+    } pending;
+
+    g_conn_handler.connections.for_each([&pending] (Interpreter& intrp) {
+        {
+            std::lock_guard l { pending.guard };
+            ++pending.count;
+        }
+        auto completed = [&pending] {
+            std::lock_guard l { pending.guard };
+            if (--pending.count == 0)
+                pending.cv.notify_all();
+        };
+        if (!intrp.flush(completed))
+            completed();
+    });
+
+    {
+        std::unique_lock l { pending.guard };
+        pending.cv.wait(l, [&pending] { return pending.count == 0; });
+    }
+
+    std::unique_lock l { g_conn_handler.guard };
+    g_conn_handler.cv_detached.wait(l, [] { return g_conn_handler.ndetached == 0; });
+}
+
+bool flush(handle_t handle, flush_callback_t callback, void *context) {
+    auto pending = false;
+    const auto found = g_conn_handler.connections.visit(reinterpret_cast<uintptr_t>(handle), [&] (Interpreter& intrp) {
+        pending = intrp.flush([=] { callback(handle, context); });
+    });
+
+    // callback isn't called inside of visit, since it may disconnect the handle
+    if (found && !pending)
+        callback(handle, context);
+    return found;
+}
+
+latency_t to_latency(const Histogram::Snapshot& histogram) {
+    return latency_t {
+        histogram.count,
+        histogram.percentile(.5),
+        histogram.percentile(.9),
+        histogram.percentile(.99),
+        histogram.percentile(.999),
+        histogram.max
+    };
+}
+
+sink_metrics_t to_sink_metrics(const Interpreter::Metrics::Sink& sink) {
+    return sink_metrics_t {
+        sink.nblocks,
+        sink.nstatements,
+        sink.nbytes,
+        sink.ndropped,
+        sink.nfailed,
+        sink.depth,
+        sink.max_depth,
+        to_latency(sink.latency)
+    };
+}
+
+std::uint64_t lost_file_blocks() {
+    std::lock_guard l { g_conn_handler.guard };
+    const FileSink* sinks[] = {
+        g_conn_handler.batched_file_sink.get(),
+        g_conn_handler.uring_file_sink.get(),
+        g_conn_handler.segment_file_sink.get(),
+        g_conn_handler.mmap_file_sink.get()
+    };
+
+    std::uint64_t ret = 0;
+    for (auto sink : sinks)
+        if (sink != nullptr)
+            ret += sink->nlost();
+    return ret;
+}
+
+metrics_t to_metrics(const Interpreter::Metrics& metrics, std::uint64_t nconnections) {
+    metrics_t ret {
+        nconnections,
+        metrics.reader.nlines,
+        metrics.reader.nstatements,
+        metrics.reader.nblocks,
+        metrics.noverflows,
+        metrics.reader.nflushed_by_size,
+        metrics.reader.nflushed_by_age,
+        metrics.reader.ncache_hits,
+        metrics.reader.ncache_misses,
+        to_latency(metrics.reader.close_latency),
+        to_sink_metrics(metrics.log),
+        to_sink_metrics(metrics.files),
+        lost_file_blocks(),
+        {}
+    };
+    for (auto i = 0u; i < metrics.sinks.size() && i < max_sink_metrics; ++i)
+        ret.sinks[i] = to_sink_metrics(metrics.sinks[i]);
+    return ret;
+}
+
+bool get_metrics(handle_t handle, metrics_t& metrics) {
+    return g_conn_handler.connections.visit(reinterpret_cast<uintptr_t>(handle), [&metrics] (Interpreter& intrp) {
+        metrics = to_metrics(intrp.get_metrics(), 0);
+    });
+}
+
+metrics_t get_metrics() {
+    auto total = [] {
+        std::lock_guard l { g_conn_handler.guard };
+        return g_conn_handler.disconnected;
+    }();
+
+    std::uint64_t nconnections = 0;
+    g_conn_handler.connections.for_each([&] (Interpreter& intrp) {
+        total += intrp.get_metrics();
+        ++nconnections;
+    });
+
+    return to_metrics(total, nconnections);
 }
 
 }
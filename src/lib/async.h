@@ -1,13 +1,263 @@
 #pragma once
 
+#include <atomic>
 #include <cstddef>
+#include <cstdint>
+
+#include <sys/uio.h>
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#include <coroutine>
+#define ASYNC_HAS_COROUTINES 1
+#endif
 
 namespace async {
 
 using handle_t = void *;
 
+enum class line_overflow_t {
+    truncate,   // the rest of too long line is dropped
+    skip        // too long line is dropped entirely
+};
+
+enum class queue_overflow_t {
+    block,  // receive waits until sinks free space
+    drop,   // bulk is dropped and counted in metrics
+    error   // bulk is dropped and try_receive reports queue_full
+};
+
+enum class result_t {
+    ok,
+    invalid_handle,
+    queue_full
+};
+
+enum class file_mode_t {
+    per_bulk,   // every bulk is written into its own file
+    batched,    // bulks are appended to long-lived files, one per pool thread;
+                // in this, compressed and mapped modes bulks of disconnected connection are written
+                // out (synced in mapped mode) by thresholds of the mode or on unloading of the library
+    uring,      // like per_bulk, but files are written through io_uring;
+                // falls back to per_bulk if it isn't built in or supported
+    compressed, // bulks are packed into zstd-compressed segments with index, one per pool thread;
+                // falls back to per_bulk if it isn't built in
+    mapped      // like batched, but files are preallocated and written through memory mapping
+};
+
+enum class disconnect_mode_t {
+    wait,   // disconnect returns once bulks are handled and metrics are logged;
+            // it's detach if disconnect is called by pool thread, e.g. by flush callback
+    detach  // disconnect returns at once; the rest is done by pool threads
+};
+
+enum class cache_eviction_t {
+    clear,      // full cache is emptied
+    generations // full cache is replaced by new one, frequent statements are moved there
+};
+
+enum class affinity_t {
+    cores,  // pool threads are pinned to single CPUs
+    nodes   // pool threads are pinned to all CPUs of NUMA nodes
+};
+
+// settings of batched file mode shared by all connections
+struct batched_files_t {
+    std::size_t flush_bytes = 64 * 1024;
+    std::size_t flush_interval_ms = 100;
+    std::size_t rotate_bytes = 64 * 1024 * 1024; // zero disables rotation
+};
+
+// settings of compressed file mode shared by all connections
+struct compressed_files_t {
+    std::size_t block_bytes = 256 * 1024;
+    std::size_t flush_interval_ms = 1000;
+    std::size_t segment_bytes = 256 * 1024 * 1024;
+    int level = 3;
+};
+
+// settings of mapped file mode shared by all connections
+struct mapped_files_t {
+    std::size_t segment_bytes = 64 * 1024 * 1024; // preallocated size of a file
+    std::size_t sync_bytes = 1024 * 1024;
+    std::size_t sync_interval_ms = 100;
+};
+
+// bulk passed to custom sink; it and its statements are valid during the call only
+struct bulk_t {
+    const char *connection;         // name of connection, not null-terminated
+    std::size_t connection_length;
+    std::uint64_t seq;              // number of bulk within connection starting from zero
+    const iovec *statements;
+    std::size_t count;
+};
+
+// custom sink fed with bulks of connection in addition to log and files
+struct sink_t {
+    // thread is index of pool thread, so sink may keep per-thread state
+    void (*write)(const bulk_t& bulk, std::size_t thread, void *context) = nullptr;
+    // called on disconnect once all bulks of connection are written; may be null
+    void (*flush)(void *context) = nullptr;
+    void *context = nullptr;
+    // pool threads writing bulks of connection at a time; zero means all of them,
+    // one keeps order of bulks
+    std::size_t concurrency = 1;
+    std::size_t batch = 0; // bulks written by a task before it yields pool thread; zero means unlimited
+    std::size_t queue_limit = 256;
+    queue_overflow_t queue_overflow = queue_overflow_t::block;
+};
+
+struct options_t {
+    std::size_t max_line_length = 0; // zero means unlimited
+    line_overflow_t line_overflow = line_overflow_t::truncate;
+    std::size_t queue_limit = 256; // bulks per sink, rounded up to power of two
+    queue_overflow_t queue_overflow = queue_overflow_t::block;
+    file_mode_t file_mode = file_mode_t::per_bulk;
+    // dynamic bulk is closed early when size of its statements reaches max_bulk_bytes
+    // or its first statement is older than max_bulk_age_ms; zero disables the limit
+    std::size_t max_bulk_bytes = 0;
+    std::size_t max_bulk_age_ms = 0;
+    // repeated statements of connection up to statement_cache_length bytes are stored once
+    // while they are in cache of statement_cache_size entries; zero size disables it
+    std::size_t statement_cache_size = 0;
+    std::size_t statement_cache_length = 256;
+    cache_eviction_t statement_cache_eviction = cache_eviction_t::generations;
+    // receive functions and flush of connection are never called concurrently,
+    // which allows to skip locking on receive
+    bool single_producer = false;
+    // disabled log or files cost nothing on receive; metrics are still logged on disconnect
+    bool log = true;
+    bool files = true;
+    const sink_t *sinks = nullptr; // copied by connect
+    std::size_t nsinks = 0;
+};
+
+// percentiles of latency in nanoseconds; relative error is below 1/8
+struct latency_t {
+    std::uint64_t count;
+    std::uint64_t p50_ns;
+    std::uint64_t p90_ns;
+    std::uint64_t p99_ns;
+    std::uint64_t p999_ns;
+    std::uint64_t max_ns;
+};
+
+struct sink_metrics_t {
+    std::uint64_t blocks;
+    std::uint64_t statements;
+    std::uint64_t bytes;
+    std::uint64_t dropped_blocks;
+    std::uint64_t failed_blocks;    // lost on I/O errors when they were written
+    std::uint64_t queue_depth;      // bulks waiting at the moment
+    std::uint64_t max_queue_depth;
+    latency_t latency;              // from closing of bulk to completion of its writing
+};
+
+// custom sinks beyond this number are left out of metrics_t
+constexpr std::size_t max_sink_metrics = 8;
+
+struct metrics_t {
+    std::uint64_t connections; // connected ones, it's zero for metrics of single connection
+    std::uint64_t lines;
+    std::uint64_t statements;
+    std::uint64_t blocks;
+    std::uint64_t overflowed_lines;
+    std::uint64_t flushed_by_size;
+    std::uint64_t flushed_by_age;
+    std::uint64_t statement_cache_hits;
+    std::uint64_t statement_cache_misses;
+    latency_t close_latency;        // from receiving of the first statement to closing of bulk
+    sink_metrics_t log;
+    sink_metrics_t files;
+    // buffered by file sinks shared by connections and lost on I/O errors later;
+    // it isn't known which connections they belong to, so it's the same for all of them
+    std::uint64_t lost_file_blocks;
+    sink_metrics_t sinks[max_sink_metrics]; // of custom sinks in order of options_t::sinks
+};
+
+// sets number of threads shared by all connections;
+// takes effect only if it's called before the first connect
+void set_pool_size(std::size_t nthreads);
+// pins pool thread i to ids[i % count]; bulks are then handled preferably by
+// threads on NUMA node of the producer; count of zero leaves threads unpinned.
+// Takes effect only if it's called before the first connect
+void set_pool_affinity(affinity_t kind, const int *ids, std::size_t count);
+// takes effect only if it's called before the first connect
+void set_batched_files(const batched_files_t& settings);
+// takes effect only if it's called before the first connect
+void set_compressed_files(const compressed_files_t& settings);
+// takes effect only if it's called before the first connect
+void set_mapped_files(const mapped_files_t& settings);
+// switches log of all connections to background writer flushing every flush_interval_ms;
+// takes effect only if it's called before the first connect
+void set_async_logger(std::size_t flush_interval_ms);
+
 handle_t connect(std::size_t bulk);
+handle_t connect(std::size_t bulk, const options_t& options);
 void receive(handle_t handle, const char *data, std::size_t size);
+result_t try_receive(handle_t handle, const char *data, std::size_t size);
+// receives buffers[i] for handles[i]; consecutive entries of the same handle
+// are consumed as continuous input under single lock of connection,
+// so buffers of a connection should be grouped together in the batch;
+// entries with invalid handles are skipped
+void receive_many(const handle_t *handles, const iovec *buffers, std::size_t count);
 void disconnect(handle_t handle);
+void disconnect(handle_t handle, disconnect_mode_t mode);
+
+using flush_callback_t = void (*)(handle_t handle, void *context);
+// calls callback once bulks closed so far by connection have been handed to log and files;
+// pending dynamic bulk isn't closed by it. Callback is called by pool thread, so it shouldn't block,
+// or by flush itself if there is nothing to wait for; either way it may disconnect the handle.
+// Returns false if handle is invalid
+bool flush(handle_t handle, flush_callback_t callback, void *context);
+
+// waits for bulks closed so far by all connections and for detached disconnects;
+// it's subject to single_producer as receive
+void flush_all();
+
+#ifdef ASYNC_HAS_COROUTINES
+// awaitable form of flush: co_await async::flushed(handle) resumes the coroutine
+// on pool thread once bulks are handed to sinks; result is false if handle is invalid
+class flush_awaitable {
+public:
+    explicit flush_awaitable(handle_t handle) noexcept : handle_(handle) {}
+
+    bool await_ready() const noexcept { return false; }
+
+    bool await_suspend(std::coroutine_handle<> continuation) {
+        continuation_ = continuation;
+        if (!flush(handle_, &flush_awaitable::on_flushed, this)) {
+            valid_ = false;
+            return false;
+        }
+        // the one of flush and callback coming second resumes the coroutine
+        return !done_.exchange(true, std::memory_order_acq_rel);
+    }
+
+    bool await_resume() const noexcept { return valid_; }
+
+private:
+    static void on_flushed(handle_t, void *context) {
+        auto self = static_cast<flush_awaitable*>(context);
+        if (self->done_.exchange(true, std::memory_order_acq_rel))
+            self->continuation_.resume();
+    }
+
+private:
+    handle_t handle_;
+    std::coroutine_handle<> continuation_;
+    std::atomic<bool> done_ { false };
+    bool valid_ { true };
+};
+
+inline flush_awaitable flushed(handle_t handle) noexcept {
+    return flush_awaitable { handle };
+}
+#endif
+
+// metrics are counted live and can be taken at any time without stopping connections;
+// returns false if handle is invalid
+bool get_metrics(handle_t handle, metrics_t& metrics);
+// totals of all connections including disconnected ones
+metrics_t get_metrics();
 
 }
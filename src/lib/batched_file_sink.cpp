@@ -0,0 +1,132 @@
+#include "batched_file_sink.h"
+
+#include <string>
+
+#include "metrics.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace griha {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Writer {
+    size_t index;
+    int fd { -1 };
+    std::string buffer;
+    size_t file_size {};
+    size_t nrecords {};
+    size_t nbuffered {}; // records in buffer
+    Counter nlost;
+    Clock::time_point last_flush { Clock::now() };
+
+    ~Writer() {
+        flush();
+        close();
+    }
+
+    void open() {
+        const auto filename = "bulks_" + std::to_string(record::now_ns()) + '_' + std::to_string(index) + ".log";
+        fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        file_size = 0;
+    }
+
+    void close() {
+        if (fd != -1)
+            ::close(fd);
+        fd = -1;
+    }
+
+    void flush() {
+        last_flush = Clock::now();
+        if (buffer.empty())
+            return;
+
+        if (fd == -1)
+            open();
+
+        const char* data = buffer.data();
+        auto size = buffer.size();
+        while (size != 0 && fd != -1) {
+            const auto n = ::write(fd, data, size);
+            if (n < 0) {
+                if (errno == EINTR)
+                    continue;
+                break;
+            }
+            data += n;
+            size -= n;
+        }
+
+        // records of buffer are lost even if they are written in part;
+        // the file is reopened by the next flush
+        file_size += buffer.size() - size;
+        if (size != 0) {
+            nlost.add(nbuffered);
+            close();
+        }
+        buffer.clear();
+        nbuffered = 0;
+    }
+};
+
+} // unnamed namespace
+
+struct BatchedFileSink::Impl {
+    const Options options;
+    PerThreadWriters<Writer> writers;
+
+    Impl(size_t nthreads, Options opts)
+        : options(opts)
+        , writers(nthreads, [] (Writer& writer, size_t index) { writer.index = index; }) {}
+};
+
+BatchedFileSink::BatchedFileSink(size_t nthreads, Options options)
+    : priv_(std::make_unique<Impl>(nthreads, options)) {}
+
+BatchedFileSink::~BatchedFileSink() = default;
+
+size_t BatchedFileSink::write(std::string_view name, const Bulk& bulk, size_t index) {
+    return priv_->writers.with(index, [&] (Writer& writer) {
+        auto& buffer = writer.buffer;
+        const auto offset = buffer.size();
+        record::append_header(buffer, name, bulk, record::now_ns(), index, writer.nrecords++);
+        record::append_statements(buffer, bulk);
+        const auto nbytes = buffer.size() - offset;
+        ++writer.nbuffered;
+
+        const auto& options = priv_->options;
+        if (buffer.size() >= options.flush_bytes || Clock::now() - writer.last_flush >= options.flush_interval)
+            writer.flush();
+
+        if (options.rotate_bytes != 0 && writer.file_size >= options.rotate_bytes)
+            writer.close();
+
+        return nbytes;
+    });
+}
+
+void BatchedFileSink::flush() {
+    priv_->writers.for_each([] (Writer& writer) { writer.flush(); });
+}
+
+void BatchedFileSink::flush_expired() {
+    const auto now = Clock::now();
+    const auto& options = priv_->options;
+    priv_->writers.for_each([now, &options] (Writer& writer) {
+        if (now - writer.last_flush >= options.flush_interval)
+            writer.flush();
+    });
+}
+
+uint64_t BatchedFileSink::nlost() const {
+    uint64_t ret = 0;
+    priv_->writers.peek([&ret] (const Writer& writer) { ret += writer.nlost.get(); });
+    return ret;
+}
+
+} // namespace griha
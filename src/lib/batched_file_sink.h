@@ -0,0 +1,46 @@
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <string_view>
+
+#include "file_sink.h"
+
+namespace griha {
+
+// Sink writing bulks of all connections into long-lived files, one file per executor thread.
+// Bulks are accumulated in memory and written by large chunks; every bulk becomes a record
+// of format described in file_sink.h
+class BatchedFileSink : public FileSink {
+
+    struct Impl;
+
+public:
+    struct Options {
+        size_t flush_bytes { 64 * 1024 };  // buffered data is written when it exceeds
+        std::chrono::milliseconds flush_interval { 100 }; // checked at every write and by flush_expired
+        size_t rotate_bytes { 64 * 1024 * 1024 }; // new file is started when it exceeds, zero disables
+    };
+
+public:
+    BatchedFileSink(size_t nthreads, Options options);
+    ~BatchedFileSink();
+
+    BatchedFileSink(const BatchedFileSink&) = delete;
+    BatchedFileSink& operator= (const BatchedFileSink&) = delete;
+
+    // writers of different threads never contend
+    size_t write(std::string_view name, const Bulk& bulk, size_t index) override;
+
+    // writes out buffered data of all threads
+    void flush() override;
+    void flush_expired() override;
+
+    uint64_t nlost() const override;
+    bool buffered() const override { return true; }
+
+private:
+    std::unique_ptr<Impl> priv_;
+};
+
+} // namespace griha
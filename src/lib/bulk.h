@@ -0,0 +1,19 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+#include "forward.h"
+#include "statement_container.h"
+
+namespace griha {
+
+// Block of statements published by Reader.
+// It's immutable after publishing, so all subscribers share the same instance
+struct Bulk {
+    StatementContainer statements;
+    std::chrono::steady_clock::time_point closed; // when block has been published
+    uint64_t seq; // number of block within connection starting from zero
+};
+
+} // namespace griha
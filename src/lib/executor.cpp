@@ -0,0 +1,247 @@
+#include "executor.h"
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include <pthread.h>
+#include <sched.h>
+
+#include "topology.h"
+
+namespace griha {
+
+namespace {
+
+// number of checks for new tasks before thread is parked
+constexpr auto c_spin_count = 64u;
+
+// pool the calling thread belongs to
+thread_local const void* t_pool = nullptr;
+
+struct Entry {
+    Executor::Task task;
+    size_t weight;
+};
+
+struct alignas(64) Queue {
+    std::mutex guard;
+    std::deque<Entry> entries;
+    std::atomic<size_t> load {}; // total weight of entries
+    int node { Executor::c_any_node }; // NUMA node of pinned thread
+    std::vector<int> cpus; // CPUs thread is pinned to
+};
+
+} // unnamed namespace
+
+struct Executor::Impl {
+
+    std::vector<std::thread> thread_pool;
+    std::vector<Queue> queues; // indexed by pool thread
+    std::mutex guard; // used only to park threads
+    std::condition_variable cv_tasks;
+    std::atomic<size_t> npending {};
+    std::atomic<size_t> nsleeping {};
+    bool stopped { false };
+    Topology topology;
+    bool pinned { false };
+
+    Impl(size_t nthreads, const Affinity& affinity);
+
+    void pin(size_t index) const;
+    Queue* least_loaded(int node);
+    void operator ()(size_t index);
+    bool spin() const;
+    bool pop(size_t index, Entry& entry);
+    bool steal(size_t index, Entry& entry);
+    bool take(Queue& queue, bool front, Entry& entry);
+};
+
+Executor::Impl::Impl(size_t nthreads, const Affinity& affinity)
+    : queues(nthreads) {
+    if (affinity.ids.empty())
+        return;
+
+    for (auto i = 0u; i < queues.size(); ++i) {
+        auto& queue = queues[i];
+        const auto id = affinity.ids[i % affinity.ids.size()];
+        if (affinity.kind == Affinity::Kind::cores) {
+            queue.cpus = { id };
+            queue.node = topology.node_of_cpu(id);
+        } else {
+            queue.cpus = topology.cpus_of_node(id);
+            queue.node = queue.cpus.empty() ? c_any_node : id;
+        }
+        pinned = pinned || queue.node != c_any_node;
+    }
+}
+
+// failure leaves thread unpinned, it affects performance only
+void Executor::Impl::pin(size_t index) const {
+    const auto& cpus = queues[index].cpus;
+    if (cpus.empty())
+        return;
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (auto cpu : cpus)
+        if (cpu >= 0 && cpu < CPU_SETSIZE)
+            CPU_SET(cpu, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+// weights are read without synchronization, so it's approximate
+Queue* Executor::Impl::least_loaded(int node) {
+    Queue* ret = nullptr;
+    for (auto& queue : queues) {
+        if (node != c_any_node && queue.node != node)
+            continue;
+        if (ret == nullptr || queue.load.load(std::memory_order_relaxed) < ret->load.load(std::memory_order_relaxed))
+            ret = &queue;
+    }
+    return ret;
+}
+
+bool Executor::Impl::spin() const {
+    for (auto i = 0u; i < c_spin_count; ++i) {
+        if (npending.load(std::memory_order_relaxed) != 0)
+            return true;
+        std::this_thread::yield();
+    }
+    return false;
+}
+
+bool Executor::Impl::take(Queue& queue, bool front, Entry& entry) {
+    std::lock_guard<std::mutex> l { queue.guard };
+    if (queue.entries.empty())
+        return false;
+
+    if (front) {
+        entry = std::move(queue.entries.front());
+        queue.entries.pop_front();
+    } else {
+        entry = std::move(queue.entries.back());
+        queue.entries.pop_back();
+    }
+    queue.load.fetch_sub(entry.weight, std::memory_order_relaxed);
+    npending.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+}
+
+bool Executor::Impl::pop(size_t index, Entry& entry) {
+    return take(queues[index], true, entry) || steal(index, entry);
+}
+
+bool Executor::Impl::steal(size_t index, Entry& entry) {
+    // victims are tried starting from the neighbour, so thieves don't pile on the same thread;
+    // the most recently posted task is stolen, the owner keeps the oldest ones.
+    // Threads of the same node are tried first, since tasks use memory of their node
+    const auto node = queues[index].node;
+    for (auto local : { true, false }) {
+        for (auto i = 1u; i < queues.size(); ++i) {
+            auto& victim = queues[(index + i) % queues.size()];
+            if ((victim.node == node) != local)
+                continue;
+            if (victim.load.load(std::memory_order_relaxed) != 0 && take(victim, false, entry))
+                return true;
+        }
+    }
+    return false;
+}
+
+void Executor::Impl::operator ()(size_t index) {
+    t_pool = this;
+    pin(index);
+
+    Entry entry;
+    for (;;) {
+        if (pop(index, entry)) {
+            entry.task(index);
+            entry.task = nullptr;
+            continue;
+        }
+
+        if (spin())
+            continue;
+
+        std::unique_lock<std::mutex> l { guard };
+        nsleeping.fetch_add(1);
+        cv_tasks.wait(l, [this] {
+            return stopped || npending.load() != 0;
+        });
+        nsleeping.fetch_sub(1);
+
+        // pending tasks are completed even if executor has been stopped
+        if (stopped && npending.load() == 0)
+            return;
+    }
+}
+
+Executor::Executor(size_t nthreads)
+    : Executor(nthreads, Affinity {}) {}
+
+Executor::Executor(size_t nthreads, Affinity affinity)
+    : priv_(std::make_unique<Impl>(nthreads == 0 ? 1 : nthreads, affinity)) {
+    nthreads = priv_->queues.size();
+
+    priv_->thread_pool.reserve(nthreads);
+    for (auto i = 0u; i < nthreads; ++i)
+        priv_->thread_pool.push_back(std::thread { std::ref(*priv_), i });
+}
+
+Executor::~Executor() {
+    {
+        std::lock_guard<std::mutex> l { priv_->guard };
+        priv_->stopped = true;
+    }
+    priv_->cv_tasks.notify_all();
+
+    for (auto& t : priv_->thread_pool)
+        if (t.joinable())
+            t.join();
+}
+
+size_t Executor::size() const {
+    return priv_->thread_pool.size();
+}
+
+bool Executor::in_pool() const {
+    return t_pool == priv_.get();
+}
+
+int Executor::local_node() const {
+    return priv_->pinned ? priv_->topology.current_node() : c_any_node;
+}
+
+void Executor::post(Task task, size_t weight, int node) {
+    // zero weight would hide the task from thieves
+    weight = std::max<size_t>(weight, 1);
+
+    // counted before it's queued, so it's never taken before counted
+    priv_->npending.fetch_add(1);
+
+    // the least loaded queue of the node, or of all threads if node has none of them
+    auto target = node != c_any_node ? priv_->least_loaded(node) : nullptr;
+    if (target == nullptr)
+        target = priv_->least_loaded(c_any_node);
+
+    {
+        std::lock_guard<std::mutex> l { target->guard };
+        target->entries.push_back(Entry { std::move(task), weight });
+        target->load.fetch_add(weight, std::memory_order_relaxed);
+    }
+
+    // either parking thread sees pending task or it's seen sleeping here
+    if (priv_->nsleeping.load() != 0) {
+        {
+            std::lock_guard<std::mutex> l { priv_->guard };
+        }
+        priv_->cv_tasks.notify_one();
+    }
+}
+
+} // namespace griha
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace griha {
+
+// Fixed-size thread pool shared by all connections.
+// Every task receives index of the pool thread it is executed by,
+// so tasks are able to keep per-thread data without synchronization.
+// Each thread has its own deque of tasks; posted task goes to the thread
+// with the least pending weight, and idle threads steal tasks of busy ones.
+// Threads may be pinned to CPUs; then tasks are posted preferably to threads
+// on NUMA node of the poster, and thieves try threads of their own node first
+class Executor {
+
+    struct Impl;
+
+public:
+    using Task = std::function<void(size_t)>;
+
+    // thread i is pinned to ids[i % ids.size()]; empty ids leave threads unpinned
+    struct Affinity {
+        enum class Kind {
+            cores,  // ids are CPUs
+            nodes   // ids are NUMA nodes, thread may run on any CPU of its node
+        } kind { Kind::cores };
+        std::vector<int> ids;
+    };
+
+    // posting thread's node is looked up only if threads are pinned
+    static constexpr int c_any_node = -1;
+
+public:
+    explicit Executor(size_t nthreads);
+    Executor(size_t nthreads, Affinity affinity);
+    ~Executor();
+
+    Executor(const Executor&) = delete;
+    Executor& operator= (const Executor&) = delete;
+
+    size_t size() const;
+
+    // true if it's called by thread of the pool
+    bool in_pool() const;
+
+    // node of the calling thread if pool threads are pinned, c_any_node otherwise
+    int local_node() const;
+
+    // weight is estimation of task cost, e.g. number of statements of a bulk;
+    // task goes to thread of given node if there is one
+    void post(Task task, size_t weight = 1, int node = c_any_node);
+
+private:
+    std::unique_ptr<Impl> priv_;
+};
+
+} // namespace griha
@@ -0,0 +1,68 @@
+#include "file_sink.h"
+
+#include <chrono>
+#include <cstring>
+
+#include "bulk.h"
+#include "statement.h"
+#include "statement_container.h"
+
+namespace griha::record {
+
+uint64_t now_ns() {
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(system_clock::now().time_since_epoch()).count();
+}
+
+void append_header(std::string& output, std::string_view name, const Bulk& bulk,
+    uint64_t time_ns, size_t index, size_t nrecord) {
+    output.append("# ").append(name.data(), name.size()).append(":").append(std::to_string(bulk.seq));
+    output.append(" ").append(std::to_string(time_ns));
+    output.append(" ").append(std::to_string(index)).append(":").append(std::to_string(nrecord));
+    output.append(" ").append(std::to_string(bulk.statements.size())).push_back('\n');
+}
+
+void append_statements(std::string& output, const Bulk& bulk) {
+    struct Printer {
+        std::string& output;
+        void operator() (const SomeStatement &stm) const {
+            output.append(stm.value().data(), stm.value().size());
+            output.push_back('\n');
+        }
+    };
+
+    Printer printer { output };
+    for (auto& stm : bulk.statements)
+        std::visit(printer, stm);
+}
+
+size_t statements_size(const Bulk& bulk) {
+    struct Measurer {
+        size_t operator() (const SomeStatement &stm) const {
+            return stm.value().size() + 1;
+        }
+    };
+
+    size_t ret = 0;
+    for (auto& stm : bulk.statements)
+        ret += std::visit(Measurer {}, stm);
+    return ret;
+}
+
+char* copy_statements(char* output, const Bulk& bulk) {
+    struct Copier {
+        char*& output;
+        void operator() (const SomeStatement &stm) const {
+            std::memcpy(output, stm.value().data(), stm.value().size());
+            output += stm.value().size();
+            *output++ = '\n';
+        }
+    };
+
+    Copier copier { output };
+    for (auto& stm : bulk.statements)
+        std::visit(copier, stm);
+    return output;
+}
+
+} // namespace griha::record
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "forward.h"
+
+namespace griha {
+
+// Destination of bulks of file worker or of pluggable sink, it may be shared by connections
+struct FileSink {
+    // returned by write if the bulk is lost on I/O error
+    static constexpr size_t c_lost = static_cast<size_t>(-1);
+
+    virtual ~FileSink() {}
+
+    // index is the executor thread index, so implementations may keep per-thread state;
+    // bulks of a connection may be written concurrently, they are ordered by sequence numbers;
+    // returns number of bytes written for the bulk, buffering sink returns size of buffered record
+    virtual size_t write(std::string_view name, const Bulk& bulk, size_t index) = 0;
+
+    // completes writing of all bulks passed before
+    virtual void flush() = 0;
+
+    // writes out data of threads kept longer than interval of the sink; it's called periodically,
+    // since sink checks the interval only when thread writes
+    virtual void flush_expired() {}
+
+    // bulks lost on I/O errors after write has accepted them, e.g. when buffer is written out
+    virtual uint64_t nlost() const { return 0; }
+
+    // sink shared by connections which writes out buffered data by its own thresholds and on destruction;
+    // it isn't flushed on disconnect, since that would write out buffers of all threads every time
+    virtual bool buffered() const { return false; }
+};
+
+// Records of long-lived files of sinks: header line
+// "# <connection>:<seq> <time_ns> <thread>:<record> <nstatements>" followed by a line per statement
+namespace record {
+
+// system time stamped on records and names of files
+uint64_t now_ns();
+
+void append_header(std::string& output, std::string_view name, const Bulk& bulk,
+    uint64_t time_ns, size_t index, size_t nrecord);
+void append_statements(std::string& output, const Bulk& bulk);
+
+// size of lines of statements, so they are copied straight into output of known size;
+// copy_statements returns the end of copied data
+size_t statements_size(const Bulk& bulk);
+char* copy_statements(char* output, const Bulk& bulk);
+
+} // namespace record
+
+// Writers of sink indexed by executor thread, so threads never contend;
+// guard of a writer is contended only by operations on all writers of the sink
+template <typename Writer>
+class PerThreadWriters {
+
+    struct Slot {
+        std::mutex guard;
+        Writer writer;
+    };
+
+public:
+    // init is called for every writer with its index
+    template <typename Init>
+    PerThreadWriters(size_t nthreads, Init&& init)
+        : slots_(nthreads) {
+        for (auto i = 0u; i < slots_.size(); ++i)
+            init(slots_[i].writer, i);
+    }
+
+    template <typename Func>
+    auto with(size_t index, Func&& func) {
+        auto& slot = slots_[index];
+        std::lock_guard<std::mutex> l { slot.guard };
+        return func(slot.writer);
+    }
+
+    template <typename Func>
+    void for_each(Func&& func) {
+        for (auto& slot : slots_) {
+            std::lock_guard<std::mutex> l { slot.guard };
+            func(slot.writer);
+        }
+    }
+
+    // writers aren't locked, so func may only read counters of them
+    template <typename Func>
+    void peek(Func&& func) const {
+        for (auto& slot : slots_)
+            func(slot.writer);
+    }
+
+private:
+    std::vector<Slot> slots_;
+};
+
+} // namespace griha
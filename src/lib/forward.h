@@ -1,13 +1,18 @@
 #pragma once
 
 #include <memory>
+#include <variant>
 #include <vector>
 
 namespace griha {
 
-struct Statement;
-using StatementPtr = std::shared_ptr<Statement>;
-using StatementContainer = std::vector<StatementPtr>;
+class SomeStatement;
+using Statement = std::variant<SomeStatement>; // text of statements is owned by arena of their block
+class StatementContainer;
+class StatementArena;
+
+struct Bulk;
+using BulkPtr = std::shared_ptr<const Bulk>;
 
 class Reader;
 
@@ -0,0 +1,280 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace griha {
+
+namespace details {
+
+// parks the thread while value is equal to expected; it may return spuriously
+inline void futex_wait(std::atomic<uint32_t>& value, uint32_t expected) {
+    static_assert(sizeof(value) == sizeof(uint32_t));
+    ::syscall(SYS_futex, reinterpret_cast<uint32_t*>(&value), FUTEX_WAIT_PRIVATE, expected, nullptr, nullptr, 0);
+}
+
+inline void futex_wake_all(std::atomic<uint32_t>& value) {
+    ::syscall(SYS_futex, reinterpret_cast<uint32_t*>(&value), FUTEX_WAKE_PRIVATE, INT32_MAX, nullptr, nullptr, 0);
+}
+
+} // namespace details
+
+// Registry of objects addressed by opaque handles.
+// Lookup is lock-free: it only touches reader counter of the slot the handle refers to,
+// so producers of different handles don't contend with each other.
+// Insertion and removal are serialized by internal mutex; removal waits until
+// all readers of the slot have left before returning ownership of the object.
+// Reader may be blocked by backpressure of the object, so removal is parked on futex
+// of reader counter and is woken by the last reader. Thread which must not wait for readers
+// removes the object with callback instead; it's called by the last reader leaving the slot.
+// Handle consists of slot index and slot generation, so stale handles
+// of removed objects are never resolved to objects inserted later
+template <typename T>
+class HandleTable {
+
+    static constexpr unsigned c_index_bits = sizeof(uintptr_t) * 4;
+    static constexpr uintptr_t c_index_mask = (uintptr_t { 1 } << c_index_bits) - 1;
+    static constexpr size_t c_segment_size = 1024;
+    static constexpr size_t c_max_segments = 4096;
+
+public:
+    using Handle = uintptr_t;
+    using Removed = std::function<void(std::unique_ptr<T>)>;
+
+private:
+    // object removed without waiting for readers of its slot
+    struct Removal {
+        HandleTable* table;
+        size_t index;
+        std::unique_ptr<T> value;
+        Removed removed;
+    };
+
+    struct alignas(64) Slot {
+        std::atomic<T*> value { nullptr };
+        std::atomic<uintptr_t> generation {};
+        std::atomic<uint32_t> readers {};
+        std::atomic<uint32_t> waiting {}; // removal is parked until readers have left
+        std::atomic<Removal*> removal { nullptr }; // slot is reused once it's completed
+    };
+    using Segment = std::array<Slot, c_segment_size>;
+
+public:
+    HandleTable() = default;
+    ~HandleTable();
+
+    HandleTable(const HandleTable&) = delete;
+    HandleTable& operator= (const HandleTable&) = delete;
+
+    // returns zero handle if table is exhausted
+    Handle insert(std::unique_ptr<T> value);
+
+    // calls func for the object referred by handle and returns true;
+    // returns false if handle is invalid
+    template <typename Func>
+    bool visit(Handle handle, Func&& func) const;
+
+    // calls func for every object in the table; objects inserted or removed
+    // concurrently may be either visited or not
+    template <typename Func>
+    void for_each(Func&& func) const;
+
+    // returns nullptr if handle is invalid
+    std::unique_ptr<T> remove(Handle handle);
+
+    // returns at once; removed is called with the object once its readers have left,
+    // either by this call or by the last reader. Returns false if handle is invalid
+    bool remove(Handle handle, Removed removed);
+
+private:
+    Slot* find(Handle handle) const;
+    static void leave(Slot& slot);
+    static void complete(Slot& slot);
+
+private:
+    std::array<std::atomic<Segment*>, c_max_segments> segments_ {};
+    size_t nslots_ {};
+    std::vector<size_t> free_slots_;
+    std::mutex guard_;
+};
+
+template <typename T>
+HandleTable<T>::~HandleTable() {
+    for (auto& segment : segments_) {
+        auto ptr = segment.load(std::memory_order_relaxed);
+        if (ptr == nullptr)
+            break;
+
+        for (auto& slot : *ptr) {
+            delete slot.value.load(std::memory_order_relaxed);
+            delete slot.removal.load(std::memory_order_relaxed);
+        }
+        delete ptr;
+    }
+}
+
+template <typename T>
+auto HandleTable<T>::insert(std::unique_ptr<T> value) -> Handle {
+    std::lock_guard<std::mutex> l { guard_ };
+
+    size_t index;
+    if (!free_slots_.empty()) {
+        index = free_slots_.back();
+        free_slots_.pop_back();
+    } else {
+        if (nslots_ == c_max_segments * c_segment_size)
+            return 0;
+
+        index = nslots_++;
+        if (index % c_segment_size == 0)
+            segments_[index / c_segment_size].store(new Segment, std::memory_order_release);
+    }
+
+    auto& slot = (*segments_[index / c_segment_size].load(std::memory_order_relaxed))[index % c_segment_size];
+    const auto generation = slot.generation.load();
+    slot.value.store(value.release());
+
+    // index is biased by one to never produce zero handle
+    return (generation << c_index_bits) | (index + 1);
+}
+
+template <typename T>
+template <typename Func>
+bool HandleTable<T>::visit(Handle handle, Func&& func) const {
+    auto slot = find(handle);
+    if (slot == nullptr)
+        return false;
+
+    // readers counter has to be published before value is checked,
+    // otherwise removal is able to miss the reader
+    slot->readers.fetch_add(1);
+    auto value = slot->value.load();
+    const auto valid = value != nullptr && slot->generation.load() == (handle >> c_index_bits);
+    if (valid)
+        func(*value);
+    leave(*slot);
+
+    return valid;
+}
+
+template <typename T>
+template <typename Func>
+void HandleTable<T>::for_each(Func&& func) const {
+    for (auto& segment : segments_) {
+        auto ptr = segment.load(std::memory_order_acquire);
+        if (ptr == nullptr)
+            break;
+
+        // the same protocol as visit, so removal waits for func to complete
+        for (auto& slot : *ptr) {
+            slot.readers.fetch_add(1);
+            if (auto value = slot.value.load())
+                func(*value);
+            leave(slot);
+        }
+    }
+}
+
+template <typename T>
+std::unique_ptr<T> HandleTable<T>::remove(Handle handle) {
+    std::unique_lock<std::mutex> l { guard_ };
+
+    auto slot = find(handle);
+    if (slot == nullptr || slot->generation.load() != (handle >> c_index_bits))
+        return nullptr;
+
+    std::unique_ptr<T> ret { slot->value.exchange(nullptr) };
+    if (!ret)
+        return nullptr;
+
+    // invalidate handle before slot is reused
+    slot->generation.store((slot->generation.load() + 1) & c_index_mask);
+
+    l.unlock();
+
+    // wait for readers which have obtained the value before it was reset;
+    // either the last reader sees removal waiting or removal sees no readers
+    slot->waiting.store(1);
+    for (auto n = slot->readers.load(); n != 0; n = slot->readers.load())
+        details::futex_wait(slot->readers, n);
+    slot->waiting.store(0, std::memory_order_relaxed);
+
+    l.lock();
+    free_slots_.push_back((handle & c_index_mask) - 1);
+    return ret;
+}
+
+template <typename T>
+bool HandleTable<T>::remove(Handle handle, Removed removed) {
+    {
+        std::lock_guard<std::mutex> l { guard_ };
+
+        auto slot = find(handle);
+        if (slot == nullptr || slot->generation.load() != (handle >> c_index_bits))
+            return false;
+
+        std::unique_ptr<T> value { slot->value.exchange(nullptr) };
+        if (!value)
+            return false;
+
+        // invalidate handle before slot is reused
+        slot->generation.store((slot->generation.load() + 1) & c_index_mask);
+        slot->removal.store(new Removal { this, (handle & c_index_mask) - 1, std::move(value), std::move(removed) });
+    }
+
+    // either the last reader sees removal pending or removal sees no readers
+    auto& slot = *find(handle);
+    if (slot.readers.load() == 0)
+        complete(slot);
+    return true;
+}
+
+template <typename T>
+void HandleTable<T>::leave(Slot& slot) {
+    if (slot.readers.fetch_sub(1) != 1)
+        return;
+
+    if (slot.waiting.load() != 0)
+        details::futex_wake_all(slot.readers);
+    if (slot.removal.load() != nullptr)
+        complete(slot);
+}
+
+// called once slot has no readers; removal is completed by one of threads racing for it
+template <typename T>
+void HandleTable<T>::complete(Slot& slot) {
+    std::unique_ptr<Removal> removal { slot.removal.exchange(nullptr) };
+    if (!removal)
+        return;
+
+    {
+        std::lock_guard<std::mutex> l { removal->table->guard_ };
+        removal->table->free_slots_.push_back(removal->index);
+    }
+    removal->removed(std::move(removal->value));
+}
+
+template <typename T>
+auto HandleTable<T>::find(Handle handle) const -> Slot* {
+    const auto biased_index = handle & c_index_mask;
+    if (biased_index == 0 || biased_index > c_max_segments * c_segment_size)
+        return nullptr;
+
+    const auto index = biased_index - 1;
+    auto segment = segments_[index / c_segment_size].load(std::memory_order_acquire);
+    if (segment == nullptr)
+        return nullptr;
+
+    return &(*segment)[index % c_segment_size];
+}
+
+} // namespace griha
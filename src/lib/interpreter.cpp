@@ -1,108 +1,296 @@
 #include "interpreter.h"
 
-#include <array>
+#include <algorithm>
+#include <atomic>
+#include <functional>
 #include <string>
+#include <utility>
 #include <vector>
-#include <list>
 #include <thread>
 #include <mutex>
 #include <condition_variable>
 #include <chrono>
+#include <cstring>
 #include <fstream>
 #include <sstream>
 
 #include <boost/format.hpp>
 
-#include <range/v3/utility/iterator.hpp>
-
+#include "bulk.h"
+#include "file_sink.h"
+#include "line_scanner.h"
+#include "metrics.h"
+#include "mpmc_queue.h"
 #include "reader.h"
 #include "reader_subscriber.h"
 #include "statement.h"
+#include "statement_container.h"
 
 namespace griha {
 
 namespace {
 
-struct Worker : ReaderSubscriber {
+constexpr size_t c_buffer_keep_capacity = 64 * 1024;
+// lines passed to reader at once
+constexpr size_t c_batch_size = 64;
+// bulks written by a file task before it yields pool thread, so files don't starve log
+constexpr size_t c_file_batch = 16;
+// blocked producer rechecks the queue even if it hasn't been notified
+constexpr auto c_space_poll_interval = std::chrono::milliseconds { 1 };
+// timer retries bulks it hasn't found space for
+constexpr auto c_deferred_retry_interval = std::chrono::milliseconds { 1 };
+
+// Bulks sent between two flushes of a worker.
+// It's released by each of its bulks, by the flush closing it and by the preceding epoch,
+// so its callback is called once all bulks sent before the flush have been handled
+struct Epoch {
+    std::atomic<size_t> npending;
+    std::function<void()> done;
+    Epoch* next {};
+
+    explicit Epoch(size_t n) : npending(n) {}
+};
 
-    struct Metrics {
-        size_t nblocks;
-        size_t nstatements;
+// Delivers published bulks to a job executed by executor.
+// Worker runs up to concurrency tasks draining its queue at a time, so concurrency of one
+// handles bulks in order of publishing; task handling a batch of bulks yields its pool thread
+// to other tasks. Worker of unlimited concurrency runs up to a task per pool thread, so bulks
+// of a connection are spread over pool threads; their order is restored by sequence numbers of bulks
+struct Worker : ReaderSubscriber, std::enable_shared_from_this<Worker> {
+
+    struct ThreadMetrics {
+        Counter nblocks;
+        Counter nstatements;
+        Counter nbytes;
+        Counter nfailed;
     };
-    
-    std::vector<Metrics> thread_metrics;
-    std::vector<std::thread> thread_pool;
+    // job receives index of executor thread it's executed by and returns number of bytes written
+    // or FileSink::c_lost
+    using Job = std::function<size_t(const Bulk&, size_t)>;
+
+    struct Item {
+        BulkPtr bulk;
+        Epoch* epoch {};
+    };
+
+    Executor& executor;
+    Job job;
+    const size_t concurrency; // never zero; unlimited one is number of pool threads
+    const size_t batch; // zero means a task drains the queue until it's empty
+    const Interpreter::QueueOverflow overflow;
+    std::vector<ThreadMetrics> thread_metrics; // indexed by executor thread
+    Histogram latency; // from publishing of bulk to completion of its job
+    MpmcQueue<Item> bulks;
+    std::atomic<size_t> nactive {}; // active tasks
+    std::atomic<size_t> nwaiting {};
+    std::atomic<size_t> max_depth {};
+    std::atomic<size_t> ndropped {};
+    Epoch* epoch { new Epoch { 1 } }; // current one; changed by producer only
+    // timer must not block, so bulks closed by it wait here for space in the queue
+    // of block policy; changed by producer or timer under guard of connection
+    bool deferring { false };
+    std::vector<Item> deferred;
+    // used only to wait for idle state or free space in the queue
     std::mutex guard;
-    std::condition_variable cv_bulks;
-    std::list<StatementContainer> bulks;
-    bool stopped { false };
-
-    template <typename Job>
-    Worker(size_t nthreads, Job&& job) 
-        : thread_metrics(nthreads, {0, 0}) {
-        thread_pool.reserve(nthreads);
-        for (auto i = 0u; i < nthreads; ++i) {
-            thread_pool.push_back(std::thread {
-                std::ref(*this), 
-                std::forward<Job>(job), std::ref(thread_metrics[i])
-            });
-        }
-    }
+    std::condition_variable cv_idle;
+    std::condition_variable cv_space;
+
+    Worker(Executor& ex, const Interpreter::SinkOptions& options, Job j)
+        : executor(ex)
+        , job(std::move(j))
+        , concurrency(options.concurrency != 0 ? options.concurrency : ex.size())
+        , batch(options.batch)
+        , overflow(options.queue_overflow)
+        , thread_metrics(ex.size())
+        , bulks(options.queue_limit) {}
 
     ~Worker() {
-        join();
+        release(epoch);
+    }
+
+    void run(const Bulk& bulk, size_t index) {
+        const auto nbytes = job(bulk, index);
+
+        // calculate metrics
+        auto& metrics = thread_metrics[index];
+        ++metrics.nblocks;
+        metrics.nstatements.add(bulk.statements.size());
+        if (nbytes != FileSink::c_lost)
+            metrics.nbytes.add(nbytes);
+        else
+            ++metrics.nfailed;
+        latency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - bulk.closed).count());
     }
 
-    template <typename Job>
-    void operator ()(Job&& job, Metrics& metrics) {
-        auto exit = false;
-        while (!exit) {
-            std::unique_lock<std::mutex> l { guard };
-            cv_bulks.wait(l, [this] {
-                return stopped || !bulks.empty();
-            });
+    // callbacks of completed epochs are posted as tasks of their own, so they never run
+    // inside of a task of worker or under lock of producer and are free to stop the connection
+    void release(Epoch* e) {
+        while (e != nullptr && e->npending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            if (e->done)
+                executor.post([done = std::move(e->done)] (size_t) { done(); });
+            delete std::exchange(e, e->next);
+        }
+    }
 
-            exit = stopped;
-            std::list<StatementContainer> bulks_local;
-            std::swap(bulks, bulks_local);
+    // closes current epoch; must be called by producer. Returned epoch is to be released by caller
+    // once flushes of all workers are started
+    Epoch* flush(std::function<void()> done) {
+        auto closed = std::exchange(epoch, new Epoch { 2 }); // it's still open and after the closed one
+        closed->done = std::move(done);
+        closed->next = epoch;
+        return closed;
+    }
 
-            l.unlock();
+    void notify(std::condition_variable& cv) {
+        {
+            std::lock_guard<std::mutex> l { guard };
+        }
+        cv.notify_all();
+    }
 
-            for (auto& stms : bulks_local) {
-                job(stms);
+    void post_task() {
+        // bulks are handled on node of producer which has allocated them
+        executor.post([self = shared_from_this()] (size_t index) {
+            (*self)(index);
+        }, 1, executor.local_node());
+    }
 
-                // calculate metrics
-                ++metrics.nblocks;
-                metrics.nstatements += stms.size();
+    void operator ()(size_t index) {
+        Item item;
+        size_t nhandled = 0;
+        do {
+            while (bulks.try_pop(item)) {
+                if (nwaiting.load(std::memory_order_relaxed) != 0)
+                    notify(cv_space);
+
+                run(*item.bulk, index);
+                item.bulk.reset();
+                release(item.epoch);
+
+                if (batch != 0 && ++nhandled >= batch && !bulks.empty()) {
+                    // task is continued by another one, so it stays active
+                    post_task();
+                    return;
+                }
             }
-        }
+
+            nactive.fetch_sub(1);
+            // bulk may have been pushed after the queue was seen empty
+            // but before the task was deactivated, so producer hasn't posted new task
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        } while (!bulks.empty() && activate());
+
+        notify(cv_idle);
     }
 
+    bool activate() {
+        return acquire(concurrency);
+    }
 
-    void send(StatementContainer stms) {
-        {
-            std::lock_guard<std::mutex> l { guard };
-            bulks.push_back(std::move(stms));
+    bool acquire(size_t max) {
+        auto n = nactive.load();
+        while (n < max)
+            if (nactive.compare_exchange_weak(n, n + 1))
+                return true;
+        return false;
+    }
+
+    void update_max_depth(size_t depth) {
+        auto max = max_depth.load(std::memory_order_relaxed);
+        while (depth > max && !max_depth.compare_exchange_weak(max, depth, std::memory_order_relaxed)) {}
+    }
+
+    // returns false if the bulk has been dropped
+    bool send(BulkPtr bulk) {
+        // epoch is held before the bulk becomes visible to task
+        epoch->npending.fetch_add(1, std::memory_order_relaxed);
+        Item item { std::move(bulk), epoch };
+
+        // deferred bulks go first, so order of bulks is kept
+        if (!push_deferred() || !bulks.try_push(item)) {
+            if (overflow != Interpreter::QueueOverflow::block) {
+                ndropped.fetch_add(1, std::memory_order_relaxed);
+                release(epoch); // current epoch is open, so it isn't completed here
+                return false;
+            }
+            if (deferring) {
+                deferred.push_back(std::move(item));
+                return true;
+            }
+            wait_for_space([this, &item] { return bulks.try_push(item); });
         }
-        cv_bulks.notify_one();
+
+        schedule();
+        return true;
     }
 
-    void stop() {
-        {
-            std::lock_guard<std::mutex> l { guard };
-            stopped = true;
+    // pushes deferred bulks; they are waited for space unless timer is pushing them.
+    // Returns false if some of them are left
+    bool push_deferred() {
+        if (deferred.empty())
+            return true;
+
+        size_t npushed = 0;
+        for (auto& item : deferred) {
+            if (!bulks.try_push(item)) {
+                if (deferring)
+                    break;
+                wait_for_space([this, &item] { return bulks.try_push(item); });
+            }
+            ++npushed;
+            schedule();
         }
-        cv_bulks.notify_all();
+        deferred.erase(deferred.begin(), deferred.begin() + npushed);
+        return deferred.empty();
+    }
+
+    // makes sure pushed bulk is taken by a task
+    void schedule() {
+        // queue high-water mark
+        update_max_depth(bulks.size());
+
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!activate())
+            return; // active tasks will take the bulk
+
+        post_task();
+    }
+
+    template <typename Push>
+    void wait_for_space(Push&& try_push) {
+        std::unique_lock<std::mutex> l { guard };
+        nwaiting.fetch_add(1);
+        // there is always active task while queue is full, so space is going to be freed
+        while (!try_push())
+            cv_space.wait_for(l, c_space_poll_interval);
+        nwaiting.fetch_sub(1);
     }
 
     void join() {
-        for (auto& t : thread_pool)
-            if (t.joinable())
-                t.join();
+        std::unique_lock<std::mutex> l { guard };
+        cv_idle.wait(l, [this] {
+            return nactive.load() == 0 && bulks.empty();
+        });
     }
 
-    void on_block(const StatementContainer& stms) override {
-        send(stms);
+    Interpreter::Metrics::Sink total_metrics() const {
+        Interpreter::Metrics::Sink ret {};
+        for (auto& m : thread_metrics) {
+            ret.nblocks += m.nblocks.get();
+            ret.nstatements += m.nstatements.get();
+            ret.nbytes += m.nbytes.get();
+            ret.nfailed += m.nfailed.get();
+        }
+        ret.ndropped = ndropped.load(std::memory_order_relaxed);
+        ret.depth = bulks.size();
+        ret.max_depth = max_depth.load(std::memory_order_relaxed);
+        ret.latency = latency.snapshot();
+        return ret;
+    }
+
+    void on_block(const BulkPtr& bulk) override {
+        send(bulk);
     }
 };
 using WorkerPtr = std::shared_ptr<Worker>;
@@ -114,114 +302,400 @@ struct Interpreter::Impl {
     const std::string name;
     Reader reader;
     Logger logger;
-    WorkerPtr log_worker;
-    WorkerPtr file_worker;
+    Executor& executor;
+    WorkerPtr log_worker; // nullptr if it's disabled
+    WorkerPtr file_worker; // nullptr if it's disabled
+    std::vector<WorkerPtr> sink_workers;
+    std::vector<WorkerPtr> workers; // all of above
+    std::vector<WorkerPtr> rejecting; // workers of QueueOverflow::error failing consume
+    FileSink* file_sink;
+    std::vector<std::shared_ptr<FileSink>> sinks;
+    TimerWheel* timers;
+    TimerWheel::Timer timer; // pending check of age of current bulk
+    // serializes producers and timer; it isn't taken if connection has single producer
     std::mutex guard;
-    bool stopped { false };
-    std::array<char, 1024> buffer {};
-    size_t buffer_size {};
-
-    Impl(std::string n, Logger l, size_t block_size, size_t nthreads) 
+    const bool locked;
+    std::atomic<bool> stopped { false };
+    const size_t max_line_length;
+    const LineOverflow line_overflow;
+    std::string buffer;
+    bool overflowed { false };
+    Line batch[c_batch_size]; // lines refer to input or to buffer until batch is flushed
+    size_t nbatched {};
+    Counter noverflows;
+
+    Impl(std::string n, const Context& context) 
         : name(std::move(n))
-        , reader(block_size)
-        , logger(l)
-        , log_worker(std::make_shared<Worker>(1u, std::bind(&Impl::log_job, std::placeholders::_1, name, logger)))
-        , file_worker(std::make_shared<Worker>(nthreads, &Impl::file_job)) {
-        reader.subscribe(log_worker);
-        reader.subscribe(file_worker);
+        , reader(context.block_size, context.bulk_limits, context.statement_cache)
+        , logger(context.logger)
+        , executor(context.executor)
+        , file_sink(context.file_sink)
+        , timers(context.timers)
+        // timer closes expired bulks concurrently with producer
+        , locked(!context.single_producer || context.timers)
+        , max_line_length(context.max_line_length)
+        , line_overflow(context.line_overflow) {
+        SinkOptions options;
+        options.queue_limit = context.queue_limit;
+        options.queue_overflow = context.queue_overflow;
+
+        // single log task per connection keeps order of bulks in log
+        if (context.log) {
+            options.concurrency = 1;
+            log_worker = std::make_shared<Worker>(executor, options,
+                std::bind(&Impl::log_job, std::placeholders::_1, name, logger));
+            workers.push_back(log_worker);
+        }
+
+        if (context.files) {
+            options.concurrency = 0;
+            options.batch = c_file_batch;
+            file_worker = std::make_shared<Worker>(executor, options, file_sink
+                ? Worker::Job { std::bind(&FileSink::write, file_sink, name, std::placeholders::_1, std::placeholders::_2) }
+                : Worker::Job { std::bind(&Impl::file_job, std::placeholders::_1, name) });
+            workers.push_back(file_worker);
+        }
+
+        for (auto& sink : context.sinks) {
+            sinks.push_back(sink.sink);
+            sink_workers.push_back(std::make_shared<Worker>(executor, sink,
+                std::bind(&FileSink::write, sink.sink, name, std::placeholders::_1, std::placeholders::_2)));
+            workers.push_back(sink_workers.back());
+        }
+
+        // disabled sinks aren't subscribed, so they cost nothing
+        for (auto& worker : workers)
+            reader.subscribe(worker);
+
+        for (auto& worker : workers)
+            if (worker->overflow == QueueOverflow::error)
+                rejecting.push_back(worker);
     }
 
-    void consume_available();
-    void consume(std::string_view data);
+    ~Impl() {
+        cancel_timer();
+    }
 
-    void on_eof();
+    // runs func on behalf of producer unless connection has been stopped
+    template <typename Func>
+    bool produce(Func&& func) {
+        if (stopped.load(std::memory_order_acquire))
+            return true;
+        if (!locked)
+            return func();
+
+        std::lock_guard l { guard };
+        if (stopped.load(std::memory_order_relaxed))
+            return true;
+        return func();
+    }
 
-    static void log_job(const StatementContainer& stms, std::string_view name, Logger logger);
-    static void file_job(const StatementContainer& stms);
+    void carry(std::string_view part);
+    void consume_line(std::string_view line, LineKind kind);
+    void flush_batch();
+    void consume_available();
+    void consume_lines(std::string_view data);
+    bool consume(std::string_view data);
+
+    size_t rejected() const;
+    void arm_timer();
+    void on_timer();
+    void cancel_timer();
+    bool stop();
+    void finish();
+    Metrics get_metrics() const;
+    void log_metrics();
+    using Epochs = std::vector<Epoch*>;
+    Epochs flush(std::function<void()> done);
+    void release(const Epochs& epochs);
+
+    static size_t log_job(const Bulk& bulk, std::string_view name, const Logger& logger);
+    static size_t file_job(const Bulk& bulk, std::string_view name);
 };
 
+void Interpreter::Impl::carry(std::string_view part) {
+    if (max_line_length != 0 && part.size() > max_line_length - buffer.size()) {
+        // the rest of line is not stored, it's handled according to overflow policy
+        part = part.substr(0, max_line_length - buffer.size());
+        overflowed = true;
+    }
+
+    buffer.append(part.data(), part.size());
+}
+
+void Interpreter::Impl::consume_line(std::string_view line, LineKind kind) {
+    if (max_line_length != 0 && (overflowed || line.size() > max_line_length)) {
+        ++noverflows;
+        if (line_overflow == LineOverflow::skip)
+            return;
+        line = line.substr(0, max_line_length);
+        kind = classify_line(line); // truncated line may become a delimiter
+    }
+
+    batch[nbatched++] = Line { line, kind };
+    if (nbatched == c_batch_size)
+        flush_batch();
+}
+
+void Interpreter::Impl::flush_batch() {
+    reader.consume(batch, nbatched);
+    nbatched = 0;
+}
+
 void Interpreter::Impl::consume_available() {
-    reader.consume(std::string { buffer.data(), buffer_size });
-    buffer_size = 0;
+    consume_line(buffer, classify_line(buffer));
+    flush_batch(); // batched line refers to buffer
+    buffer.clear();
+    overflowed = false;
+
+    // memory occupied by extremely long line is not kept for connection lifetime
+    if (buffer.capacity() > c_buffer_keep_capacity)
+        std::string {}.swap(buffer);
 }
 
-void Interpreter::Impl::consume(std::string_view data) {
-    for (auto i = 0u; i < data.size(); ++i) {
-        if (data[i] == '\n') {
-            consume_available();
+// bulks dropped by workers of other policies don't fail consume
+size_t Interpreter::Impl::rejected() const {
+    size_t ret = 0;
+    for (auto& worker : rejecting)
+        ret += worker->ndropped.load(std::memory_order_relaxed);
+    return ret;
+}
+
+bool Interpreter::Impl::consume(std::string_view data) {
+    const auto nrejected = rejected();
+    consume_lines(data);
+    arm_timer();
+    return rejected() == nrejected;
+}
+
+void Interpreter::Impl::consume_lines(std::string_view data) {
+    // index is used only during the call, so it's kept per thread instead of per connection;
+    // input is classified window by window, so index stays small
+    thread_local LineIndex index;
+    while (!data.empty()) {
+        const auto window = data.substr(0, LineIndex::c_max_size);
+        index.scan(window);
+        if (index.empty()) {
+            // partial line is kept until the rest of it is received
+            carry(window);
+            data.remove_prefix(window.size());
             continue;
         }
 
-        buffer.at(buffer_size) = data[i];
-        ++buffer_size;
+        size_t begin = 0;
+        for (auto mark : index) {
+            const auto line = window.substr(begin, mark.end() - begin);
+            if (buffer.empty() && !overflowed) {
+                // complete line is passed from input directly
+                consume_line(line, mark.kind());
+            } else {
+                // kind of the first line is unknown since it continues carried part
+                carry(line);
+                consume_available();
+            }
+            begin = mark.end() + 1;
+        }
+        data.remove_prefix(begin);
     }
+
+    flush_batch();
 }
 
-void Interpreter::Impl::on_eof() {
-    if (buffer_size != 0)
-        consume_available();
+// must be called under guard
+void Interpreter::Impl::arm_timer() {
+    if (!timers || timer)
+        return;
+
+    auto deadline = reader.expires_at();
+    for (auto& worker : workers)
+        if (!worker->deferred.empty()) {
+            const auto retry = Reader::Clock::now() + c_deferred_retry_interval;
+            deadline = deadline ? std::min(*deadline, retry) : retry;
+            break;
+        }
+
+    if (deadline)
+        timer = timers->schedule(*deadline, [this] { on_timer(); });
+}
+
+// timer is shared by all connections, so bulks found no space for are deferred instead of waiting
+void Interpreter::Impl::on_timer() {
+    std::lock_guard l { guard };
+    timer = {};
+    if (stopped.load(std::memory_order_relaxed))
+        return;
 
+    for (auto& worker : workers) {
+        worker->deferring = true;
+        worker->push_deferred();
+    }
+    reader.on_timer(Reader::Clock::now());
+    for (auto& worker : workers)
+        worker->deferring = false;
+
+    // bulk started after the expired one needs check of its own
+    arm_timer();
+}
+
+void Interpreter::Impl::cancel_timer() {
+    TimerWheel::Timer pending;
+    {
+        std::lock_guard l { guard };
+        stopped.store(true); // running callback won't arm timer again
+        pending = std::exchange(timer, {});
+    }
+
+    // waits outside of guard for callback which may be waiting for it
+    if (pending)
+        timers->cancel(pending);
+}
+
+// must be called by producer
+auto Interpreter::Impl::flush(std::function<void()> done) -> Epochs {
+    struct Join {
+        std::atomic<size_t> npending;
+        std::function<void()> done;
+    };
+
+    // callback is called by the worker completing its epoch last
+    auto join = std::make_shared<Join>();
+    join->npending = workers.size();
+    join->done = std::move(done);
+    auto completed = [join] {
+        if (join->npending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            join->done();
+    };
+
+    Epochs ret;
+    for (auto& worker : workers)
+        ret.push_back(worker->flush(completed));
+    return ret;
+}
+
+void Interpreter::Impl::release(const Epochs& epochs) {
+    for (auto i = 0u; i < epochs.size(); ++i)
+        workers[i]->release(epochs[i]);
+}
+
+// returns false if connection has been already stopped
+bool Interpreter::Impl::stop() {
+    if (stopped.load(std::memory_order_acquire))
+        return false;
+
+    {
+        std::lock_guard l { guard };
+        if (stopped.exchange(true))
+           return false;
+    }
+
+    cancel_timer();
+
+    // producers and timer are stopped, so the rest of input is published without guard
+    if (!buffer.empty() || overflowed)
+        consume_available();
     reader.on_eof();
+    for (auto& worker : workers)
+        worker->push_deferred();
+    return true;
+}
 
-    // stop workers
-    log_worker->stop();
-    file_worker->stop();
-    // wait for completing
-    log_worker->join();
-    file_worker->join();
+// must be called after all bulks have been handled
+void Interpreter::Impl::finish() {
+    if (file_worker && file_sink && !file_sink->buffered())
+        file_sink->flush();
+    for (auto& sink : sinks)
+        sink->flush();
 
+    log_metrics();
+    // nothing of connection is kept in buffers of logger after disconnect
+    logger.flush();
 }
 
-void Interpreter::Impl::log_job(const StatementContainer& stms, std::string_view name, Logger logger) {
-    using namespace std;
-    using namespace ranges;
+size_t Interpreter::Impl::log_job(const Bulk& bulk, std::string_view name, const Logger& logger) {
+    using namespace std::string_view_literals;
 
-    std::ostringstream os;
+    const auto& stms = bulk.statements;
+
+    constexpr auto c_bulk_prefix = "] bulk: "sv;
+    constexpr auto c_separator = ", "sv;
+
+    struct Measurer {
+        size_t size {};
+        void operator() (const SomeStatement &stm) {
+            size += stm.value().size();
+        }
+    } measurer;
+
+    struct Formatter {
+        char* out;
+        bool first { true };
 
-    struct LoggerExecuter : Executer {
-        
-        ostream_joiner<std::string> osj;
+        explicit Formatter(char* o) : out(o) {}
 
-        explicit LoggerExecuter(std::ostream& output)
-            : osj(output, ", ") {}
-        
-        void execute(const SomeStatement &stm) override {
-            *osj = stm.value();
+        void append(std::string_view value) {
+            std::memcpy(out, value.data(), value.size());
+            out += value.size();
         }
-    } logger_executer { os };
 
-    os << '[' << name << "] bulk: ";
+        void operator() (const SomeStatement &stm) {
+            if (!first)
+                append(c_separator);
+            first = false;
+            append(stm.value());
+        }
+    };
+
     for (auto& stm : stms)
-        stm->execute(logger_executer);
-    
-    logger.log(os.str());
+        std::visit(measurer, stm);
+
+    const auto nseparators = stms.empty() ? 0 : stms.size() - 1;
+    const auto size = 1 + name.size() + c_bulk_prefix.size() + measurer.size + nseparators * c_separator.size();
+
+    // buffer keeps its capacity between bulks, so formatting doesn't allocate in steady state
+    thread_local std::string buffer;
+    buffer.resize(size);
+
+    Formatter formatter { buffer.data() };
+    formatter.append("["sv);
+    formatter.append(name);
+    formatter.append(c_bulk_prefix);
+    for (auto& stm : stms)
+        std::visit(formatter, stm);
+
+    logger.log(buffer);
+    return size;
 }
 
-void Interpreter::Impl::file_job(const StatementContainer& stms) {
+size_t Interpreter::Impl::file_job(const Bulk& bulk, std::string_view name) {
     using namespace std;
     
-    struct Printer : Executer {
+    struct Printer {
         ofstream output;
-        void execute(const SomeStatement &stm) override {
+        size_t nbytes {};
+        void operator() (const SomeStatement &stm) {
             output << stm.value() << endl;
+            nbytes += stm.value().size() + 1;
         }
     };
     
     const auto now = chrono::system_clock::now();
     const auto now_ns = chrono::duration_cast<chrono::nanoseconds>(now.time_since_epoch());
-    const auto filename = ( boost::format { "bulk_%1%_%2%.log"s }
+    // connection name and sequence number make file name unique and restore order of bulks
+    const auto filename = ( boost::format { "bulk_%1%_%2%_%3%.log"s }
                                 % now_ns.count()
-                                % std::this_thread::get_id() ).str();
+                                % name
+                                % bulk.seq ).str();
 
     Printer printer;
 
     printer.output.open(filename);
 
-    for (auto& stm : stms)
-        stm->execute(printer);
+    for (auto& stm : bulk.statements)
+        std::visit(printer, stm);
 
     printer.output.flush();
     printer.output.close();
+    return printer.output ? printer.nbytes : FileSink::c_lost;
 }
 
 Interpreter::~Interpreter() = default;
@@ -229,66 +703,183 @@ Interpreter::Interpreter(Interpreter&&) = default;
 Interpreter& Interpreter::operator= (Interpreter&&) = default;
     
 Interpreter::Interpreter(Context context, std::string name)
-    : priv_(std::make_unique<Impl>(
-        std::move(name),
-        std::move(context.logger),
-        context.block_size,
-        context.nthreads))
+    : priv_(std::make_unique<Impl>(std::move(name), context))
 {}
 
-void Interpreter::consume(std::string_view data) {
-    if (priv_->stopped)
-        return;
+bool Interpreter::consume(std::string_view data) {
+    return priv_->produce([this, data] {
+        return priv_->consume(data);
+    });
+}
 
-    std::lock_guard l { priv_->guard };
-    if (priv_->stopped)
-        return;
+bool Interpreter::consume(const iovec* parts, size_t nparts) {
+    return priv_->produce([this, parts, nparts] {
+        auto accepted = true;
+        for (auto i = 0u; i < nparts; ++i)
+            accepted = priv_->consume({ static_cast<const char*>(parts[i].iov_base), parts[i].iov_len }) && accepted;
+        return accepted;
+    });
+}
+
+bool Interpreter::flush(std::function<void()> done) {
+    Impl::Epochs epochs;
+    priv_->produce([this, &done, &epochs] {
+        if (!priv_->workers.empty())
+            epochs = priv_->flush(std::move(done));
+        return true;
+    });
+
+    // stopped connection has handled all its bulks, connection without sinks has nothing to wait for
+    if (epochs.empty())
+        return false;
+
+    priv_->release(epochs);
+    return true;
+}
+
+auto Interpreter::Metrics::Sink::operator+= (const Sink& other) -> Sink& {
+    nblocks += other.nblocks;
+    nstatements += other.nstatements;
+    nbytes += other.nbytes;
+    ndropped += other.ndropped;
+    nfailed += other.nfailed;
+    depth += other.depth;
+    max_depth = std::max(max_depth, other.max_depth);
+    latency += other.latency;
+    return *this;
+}
+
+auto Interpreter::Metrics::operator+= (const Metrics& other) -> Metrics& {
+    reader.nlines += other.reader.nlines;
+    reader.nstatements += other.reader.nstatements;
+    reader.nblocks += other.reader.nblocks;
+    reader.nflushed_by_size += other.reader.nflushed_by_size;
+    reader.nflushed_by_age += other.reader.nflushed_by_age;
+    reader.ncache_hits += other.reader.ncache_hits;
+    reader.ncache_misses += other.reader.ncache_misses;
+    reader.close_latency += other.reader.close_latency;
+    noverflows += other.noverflows;
+    log += other.log;
+    files += other.files;
+    if (sinks.size() < other.sinks.size())
+        sinks.resize(other.sinks.size());
+    for (auto i = 0u; i < other.sinks.size(); ++i)
+        sinks[i] += other.sinks[i];
+    return *this;
+}
+
+auto Interpreter::Impl::get_metrics() const -> Metrics {
+    Metrics ret {
+        reader.get_metrics(),
+        noverflows.get(),
+        log_worker ? log_worker->total_metrics() : Metrics::Sink {},
+        file_worker ? file_worker->total_metrics() : Metrics::Sink {},
+        {}
+    };
+    for (auto& worker : sink_workers)
+        ret.sinks.push_back(worker->total_metrics());
+    return ret;
+}
 
-    priv_->consume(data);
+auto Interpreter::get_metrics() const -> Metrics {
+    return priv_->get_metrics();
 }
 
 void Interpreter::stop_and_log_metrics() const {
-    if (priv_->stopped)
+    if (!priv_->stop())
         return;
 
-    {
-        std::lock_guard l { priv_->guard };
-        if (priv_->stopped)
-           return;
-        priv_->stopped = true;
-    }
+    // wait for completing of all bulks sent to executor
+    for (auto& worker : priv_->workers)
+        worker->join();
 
-    priv_->on_eof();
+    priv_->finish();
+}
 
-    // print metrics
-    decltype(auto) reader_metrics = priv_->reader.get_metrics();
+void Interpreter::stop_and_log_metrics(std::function<void()> done) const {
+    if (!priv_->stop())
+        return;
+
+    // the last bulks are followed by end of epochs instead of joining workers;
+    // the rest is done by pool thread even if nothing is pending
+    auto impl = priv_.get();
+    auto completed = [impl, done = std::move(done)] {
+        impl->finish();
+        done();
+    };
+
+    if (impl->workers.empty())
+        impl->executor.post([completed = std::move(completed)] (size_t) { completed(); });
+    else
+        impl->release(impl->flush(std::move(completed)));
+}
+
+void Interpreter::Impl::log_metrics() {
+    const auto metrics = get_metrics();
+    const auto& reader_metrics = metrics.reader;
 
     std::ostringstream os;
-    os << '[' << priv_->name << "] Metrics" << std::endl;
+    os << '[' << name << "] Metrics" << std::endl;
     os << "\tReader:" << std::endl;
     os
         << "\t\tlines - " << reader_metrics.nlines
         << "; statements - " << reader_metrics.nstatements
         << "; blocks - " << reader_metrics.nblocks
+        << "; overflowed lines - " << metrics.noverflows
+        << "; flushed by size - " << reader_metrics.nflushed_by_size
+        << "; flushed by age - " << reader_metrics.nflushed_by_age
         << std::endl;
+    if (reader_metrics.ncache_hits + reader_metrics.ncache_misses != 0) {
+        os
+            << "\t\tcache hits - " << reader_metrics.ncache_hits
+            << "; cache misses - " << reader_metrics.ncache_misses
+            << std::endl;
+    }
     
-    os << "\tLog:" << std::endl;
-    os
-        << "\t\tblocks - " << priv_->log_worker->thread_metrics[0].nblocks
-        << "; statements - " << priv_->log_worker->thread_metrics[0].nstatements
-        << std::endl;
+    if (log_worker) {
+        os << "\tLog:" << std::endl;
+        os
+            << "\t\tblocks - " << metrics.log.nblocks
+            << "; statements - " << metrics.log.nstatements
+            << "; max queue depth - " << metrics.log.max_depth
+            << "; dropped blocks - " << metrics.log.ndropped
+            << std::endl;
+    }
 
-    os << "\tFiles:" << std::endl;
-    for (auto i = 0u; i < priv_->file_worker->thread_metrics.size(); ++i) {
-        auto &m = priv_->file_worker->thread_metrics[i];
+    if (file_worker) {
+        os << "\tFiles:" << std::endl;
         os
-            << "\t#" << i
-            << "\tblocks - " << m.nblocks
+            << "\t\tmax queue depth - " << metrics.files.max_depth
+            << "; dropped blocks - " << metrics.files.ndropped;
+        if (metrics.files.nfailed != 0)
+            os << "; failed blocks - " << metrics.files.nfailed;
+        os << std::endl;
+        for (auto i = 0u; i < file_worker->thread_metrics.size(); ++i) {
+            auto &m = file_worker->thread_metrics[i];
+            if (m.nblocks.get() == 0)
+                continue; // executor thread hasn't processed bulks of this connection
+            os
+                << "\t#" << i
+                << "\tblocks - " << m.nblocks.get()
+                << "; statements - " << m.nstatements.get()
+                << std::endl;
+        }
+    }
+
+    for (auto i = 0u; i < metrics.sinks.size(); ++i) {
+        auto& m = metrics.sinks[i];
+        os << "\tSink #" << i << ':' << std::endl;
+        os
+            << "\t\tblocks - " << m.nblocks
             << "; statements - " << m.nstatements
-            << std::endl;
+            << "; max queue depth - " << m.max_depth
+            << "; dropped blocks - " << m.ndropped;
+        if (m.nfailed != 0)
+            os << "; failed blocks - " << m.nfailed;
+        os << std::endl;
     }
     
-    priv_->logger.log(os.str());
+    logger.log(os.str());
 }
 
-} // namespace griha
\ No newline at end of file
+} // namespace griha
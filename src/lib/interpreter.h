@@ -1,12 +1,20 @@
 #pragma once
 
+#include <functional>
 #include <string>
 #include <string_view>
 #include <memory>
+#include <vector>
+
+#include <sys/uio.h>
 
 #include "forward.h"
+#include "executor.h"
+#include "file_sink.h"
 #include "logger.h"
+#include "metrics.h"
 #include "reader.h"
+#include "timer_wheel.h"
 
 namespace griha {
 
@@ -15,10 +23,74 @@ class Interpreter {
     struct Impl;
 
 public:
+    // handling of lines longer than maximum line length
+    enum class LineOverflow {
+        truncate,   // the rest of line is dropped
+        skip        // whole line is dropped
+    };
+
+    // handling of bulks which don't fit into queue of a worker
+    enum class QueueOverflow {
+        block,  // producer waits for free space
+        drop,   // bulk is dropped and counted
+        error   // bulk is dropped and consume reports failure
+    };
+
+    // sink fed with bulks of connection by its own worker
+    struct SinkOptions {
+        std::shared_ptr<FileSink> sink;
+        // maximum number of pool threads writing bulks of connection at a time;
+        // zero means a task per pool thread, one keeps order of bulks
+        size_t concurrency {};
+        // bulks written by a task before it yields pool thread; zero means unlimited
+        size_t batch {};
+        size_t queue_limit { 256 }; // rounded up to power of two
+        QueueOverflow queue_overflow { QueueOverflow::block };
+    };
+
     struct Context {
         Logger logger;
+        Executor& executor;
         size_t block_size;
-        size_t nthreads;
+        size_t max_line_length {}; // zero means unlimited
+        LineOverflow line_overflow { LineOverflow::truncate };
+        size_t queue_limit { 256 }; // per worker, rounded up to power of two
+        QueueOverflow queue_overflow { QueueOverflow::block };
+        FileSink* file_sink {}; // shared batched sink; nullptr means a file per bulk
+        bool log { true };      // disabled log and files aren't subscribed to reader at all
+        bool files { true };
+        std::vector<SinkOptions> sinks {}; // sinks fed in addition to log and files
+        Reader::Limits bulk_limits {};
+        StatementFactory::Options statement_cache {}; // disabled by default
+        TimerWheel* timers {}; // required if age of bulks is limited
+        // consume is called by one thread at a time and never concurrently with stop,
+        // so producers aren't synchronized unless timer has to be
+        bool single_producer {};
+    };
+
+    // snapshot of connection metrics; it may be taken at any time
+    struct Metrics {
+        struct Sink {
+            size_t nblocks;
+            size_t nstatements;
+            size_t nbytes;
+            size_t ndropped;
+            size_t nfailed;     // bulks lost on I/O errors when they were written
+            size_t depth;       // bulks in queue
+            size_t max_depth;
+            Histogram::Snapshot latency; // nanoseconds from publishing of block to completion of its writing
+
+            // counters and histograms are summed up, high-water mark is maximized
+            Sink& operator+= (const Sink& other);
+        };
+
+        Reader::Metrics reader;
+        size_t noverflows;
+        Sink log;
+        Sink files;
+        std::vector<Sink> sinks; // in order of Context::sinks
+
+        Metrics& operator+= (const Metrics& other);
     };
 
 public:
@@ -31,8 +103,20 @@ public:
     Interpreter(const Interpreter&) = delete;
     Interpreter& operator= (const Interpreter&) = delete;
 
-    void consume(std::string_view data);
+    // returns false if some bulks have been rejected according to QueueOverflow::error
+    bool consume(std::string_view data);
+    // consumes buffers one after another as a single piece of input under one lock
+    bool consume(const iovec* parts, size_t nparts);
+    // calls done by pool thread once bulks published so far have been handed to sinks;
+    // current dynamic block isn't closed by it. Returns false without calling done
+    // if there is nothing to wait for; it's subject to single_producer as consume
+    bool flush(std::function<void()> done);
+    Metrics get_metrics() const;
+    // waits for all bulks to be handled
     void stop_and_log_metrics() const;
+    // returns without waiting; done is called by pool thread once bulks are handled
+    // and metrics are logged. Interpreter must be kept alive until then
+    void stop_and_log_metrics(std::function<void()> done) const;
 
 private:
     std::unique_ptr<Impl> priv_;
@@ -0,0 +1,132 @@
+#include "line_scanner.h"
+
+#include <cstring>
+
+#include "line_scanner_impl.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace griha {
+
+namespace {
+
+using namespace std::string_view_literals;
+
+constexpr auto c_explicit_block_begin   = "{"sv;
+constexpr auto c_explicit_block_end     = "}"sv;
+
+#if defined(__SSE2__)
+
+struct Sse2 {
+    static BlockMasks masks(const char* p) {
+        const auto newline = _mm_set1_epi8('\n');
+        const auto mask = _mm_set1_epi8(c_delimiter_mask);
+        const auto bits = _mm_set1_epi8(c_delimiter_bits);
+
+        BlockMasks ret {};
+        for (auto i = 0u; i < 4; ++i) {
+            const auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 16 * i));
+            const auto nl = static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, newline)));
+            const auto dl = static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(v, mask), bits)));
+            ret.newline |= uint64_t { nl } << (16 * i);
+            ret.delimiter |= uint64_t { dl } << (16 * i);
+        }
+        return ret;
+    }
+};
+using Kernel = Sse2;
+
+#elif defined(__aarch64__)
+
+struct Neon {
+    // NEON has no movemask: every matching lane keeps its bit, lanes are summed per half
+    static uint64_t movemask(uint8x16_t m) {
+        static const uint8_t c_bits[16] = { 1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 };
+        const auto t = vandq_u8(m, vld1q_u8(c_bits));
+        return uint64_t { vaddv_u8(vget_low_u8(t)) } | (uint64_t { vaddv_u8(vget_high_u8(t)) } << 8);
+    }
+
+    static BlockMasks masks(const char* p) {
+        const auto u = reinterpret_cast<const uint8_t*>(p);
+        const auto newline = vdupq_n_u8('\n');
+        const auto mask = vdupq_n_u8(static_cast<uint8_t>(c_delimiter_mask));
+        const auto bits = vdupq_n_u8(c_delimiter_bits);
+
+        BlockMasks ret {};
+        for (auto i = 0u; i < 4; ++i) {
+            const auto v = vld1q_u8(u + 16 * i);
+            ret.newline |= movemask(vceqq_u8(v, newline)) << (16 * i);
+            ret.delimiter |= movemask(vceqq_u8(vandq_u8(v, mask), bits)) << (16 * i);
+        }
+        return ret;
+    }
+};
+using Kernel = Neon;
+
+#endif
+
+#if !defined(__SSE2__) && !defined(__aarch64__)
+
+size_t scan_lines_scalar(const char* data, size_t size, uint32_t* out) {
+    size_t n = 0;
+    for (size_t begin = 0; begin < size;) {
+        auto eol = static_cast<const char*>(std::memchr(data + begin, '\n', size - begin));
+        if (eol == nullptr)
+            break;
+
+        const auto end = static_cast<size_t>(eol - data);
+        const auto kind = static_cast<uint32_t>(classify_line({ data + begin, end - begin }));
+        out[n++] = static_cast<uint32_t>(end) | (kind << c_kind_shift);
+        begin = end + 1;
+    }
+    return n;
+}
+
+#endif
+
+using ScanLines = size_t (*)(const char*, size_t, uint32_t*);
+
+ScanLines select_scan_lines() {
+#ifdef ASYNC_WITH_AVX2
+    if (__builtin_cpu_supports("avx2"))
+        return &details::scan_lines_avx2;
+#endif
+    return &details::scan_lines_baseline;
+}
+
+const ScanLines c_scan_lines = select_scan_lines();
+
+} // unnamed namespace
+
+size_t details::scan_lines_baseline(const char* data, size_t size, uint32_t* out) {
+#if defined(__SSE2__) || defined(__aarch64__)
+    return scan_blocks<Kernel>(data, size, out);
+#else
+    return scan_lines_scalar(data, size, out);
+#endif
+}
+
+LineKind classify_line(std::string_view line) {
+    if (line == c_explicit_block_begin)
+        return LineKind::block_begin;
+    if (line == c_explicit_block_end)
+        return LineKind::block_end;
+    return LineKind::statement;
+}
+
+void LineIndex::scan(std::string_view data) {
+    // there are no more lines than bytes
+    if (capacity_ < data.size()) {
+        capacity_ = data.size();
+        marks_ = std::make_unique<Mark[]>(capacity_);
+    }
+
+    static_assert(sizeof(Mark) == sizeof(uint32_t), "mark is written as plain integer");
+    size_ = c_scan_lines(data.data(), data.size(), reinterpret_cast<uint32_t*>(marks_.get()));
+}
+
+} // namespace griha
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string_view>
+
+namespace griha {
+
+enum class LineKind : uint8_t {
+    statement,
+    block_begin,    // line is exactly "{"
+    block_end       // line is exactly "}"
+};
+
+// line classified in advance, e.g. by LineIndex
+struct Line {
+    std::string_view text;
+    LineKind kind;
+};
+
+LineKind classify_line(std::string_view line);
+
+// Index of complete lines of a buffer built in one vectorized pass (AVX2 or SSE2 on x86,
+// NEON on ARM, memchr elsewhere). Every mark is end offset of a line with its kind,
+// so lines don't need to be compared with block delimiters again
+class LineIndex {
+public:
+    // limited so offset and kind share 32 bits of a mark
+    static constexpr size_t c_max_size = 64 * 1024;
+    static constexpr unsigned c_kind_shift = 30;
+    static constexpr uint32_t c_offset_mask = (uint32_t { 1 } << c_kind_shift) - 1;
+
+    struct Mark {
+        uint32_t value;
+
+        size_t end() const { return value & c_offset_mask; } // offset of newline
+        LineKind kind() const { return static_cast<LineKind>(value >> c_kind_shift); }
+    };
+
+public:
+    // data of at most c_max_size bytes is supposed to start at beginning of line;
+    // marks of previous scan are discarded
+    void scan(std::string_view data);
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    const Mark* begin() const { return marks_.get(); }
+    const Mark* end() const { return marks_.get() + size_; }
+
+private:
+    std::unique_ptr<Mark[]> marks_; // capacity is kept between scans
+    size_t capacity_ {};
+    size_t size_ {};
+};
+
+} // namespace griha
@@ -0,0 +1,42 @@
+// compiled with AVX2 enabled; it's called only if CPU supports it
+#include "line_scanner_impl.h"
+
+#include <immintrin.h>
+
+namespace griha {
+
+namespace {
+
+struct Avx2 {
+    static uint64_t movemask(__m256i lo, __m256i hi) {
+        const auto mlo = static_cast<uint32_t>(_mm256_movemask_epi8(lo));
+        const auto mhi = static_cast<uint32_t>(_mm256_movemask_epi8(hi));
+        return uint64_t { mlo } | (uint64_t { mhi } << 32);
+    }
+
+    static BlockMasks masks(const char* p) {
+        const auto lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        const auto hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 32));
+
+        const auto newline = _mm256_set1_epi8('\n');
+        const auto mask = _mm256_set1_epi8(c_delimiter_mask);
+        const auto bits = _mm256_set1_epi8(c_delimiter_bits);
+        return BlockMasks {
+            movemask(_mm256_cmpeq_epi8(lo, newline), _mm256_cmpeq_epi8(hi, newline)),
+            movemask(_mm256_cmpeq_epi8(_mm256_and_si256(lo, mask), bits),
+                _mm256_cmpeq_epi8(_mm256_and_si256(hi, mask), bits))
+        };
+    }
+};
+
+} // unnamed namespace
+
+namespace details {
+
+size_t scan_lines_avx2(const char* data, size_t size, uint32_t* out) {
+    return scan_blocks<Avx2>(data, size, out);
+}
+
+} // namespace details
+
+} // namespace griha
@@ -0,0 +1,88 @@
+#pragma once
+
+// Block loop shared by vectorized kernels of LineIndex.
+// Loop and kernels have internal linkage, so code compiled for a particular
+// instruction set never leaks into translation units compiled for another one
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "line_scanner.h"
+
+namespace griha {
+
+namespace details {
+
+// marks are written as plain integers: offset in low 30 bits, LineKind above
+size_t scan_lines_avx2(const char* data, size_t size, uint32_t* out);
+// kernel of target instruction set (SSE2, NEON or memchr); it's used if AVX2 isn't available
+size_t scan_lines_baseline(const char* data, size_t size, uint32_t* out);
+
+} // namespace details
+
+namespace {
+
+constexpr auto c_kind_shift = LineIndex::c_kind_shift;
+constexpr size_t c_block_size = 64;
+
+// "{" and "}" differ in bits 1 and 2 only, so both are found by single comparison
+// of masked byte; the other bytes matching it ('y' and DEL) are told apart on newline
+constexpr char c_delimiter_mask = static_cast<char>(0xf9);
+constexpr char c_delimiter_bits = 0x79;
+
+// bit i is set if byte i of 64-byte block matches
+struct BlockMasks {
+    uint64_t newline;
+    uint64_t delimiter; // may be "{" or "}"
+};
+
+struct ScanState {
+    uint64_t line_start { 1 };      // the first byte of the next block starts a line
+    uint64_t delimiter_carry {};    // the last byte of block may be delimiter starting a line
+};
+
+inline size_t emit(const BlockMasks& masks, const char* data, size_t offset, ScanState& state,
+    uint32_t* out, size_t n) {
+    // byte starts a line if it follows newline
+    const auto start = (masks.newline << 1) | state.line_start;
+    state.line_start = masks.newline >> 63;
+
+    // delimiter is a line of its own if it starts a line and is followed by newline
+    const auto single = masks.delimiter & start;
+    const auto single_lines = ((single << 1) | state.delimiter_carry) & masks.newline;
+    state.delimiter_carry = single >> 63;
+
+    for (auto nl = masks.newline; nl != 0; nl &= nl - 1) {
+        const auto pos = offset + __builtin_ctzll(nl);
+        uint32_t kind = 0;
+        if (single_lines & nl & (~nl + 1)) {
+            const auto c = data[pos - 1];
+            kind = c == '{' ? 1 : c == '}' ? 2 : 0;
+        }
+        out[n++] = static_cast<uint32_t>(pos) | (kind << c_kind_shift);
+    }
+    return n;
+}
+
+// Kernel::masks reads exactly c_block_size bytes
+template <typename Kernel>
+size_t scan_blocks(const char* data, size_t size, uint32_t* out) {
+    ScanState state;
+    size_t n = 0;
+    size_t offset = 0;
+    for (; offset + c_block_size <= size; offset += c_block_size)
+        n = emit(Kernel::masks(data + offset), data, offset, state, out, n);
+
+    if (offset < size) {
+        // tail is padded with zeros which match nothing
+        alignas(c_block_size) char tail[c_block_size] = {};
+        std::memcpy(tail, data + offset, size - offset);
+        n = emit(Kernel::masks(tail), data, offset, state, out, n);
+    }
+    return n;
+}
+
+} // unnamed namespace
+
+} // namespace griha
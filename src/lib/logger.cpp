@@ -1,24 +1,282 @@
 #include "logger.h"
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
 #include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
 
 namespace griha {
 
 struct Logger::Impl {
+    virtual ~Impl() {}
+    virtual void log(std::string_view message) = 0;
+    virtual void flush() {}
+};
+
+struct Logger::SyncImpl : Logger::Impl {
 
     std::ostream& output;
     std::mutex guard;
 
-    explicit Impl(std::ostream& os)
+    explicit SyncImpl(std::ostream& os)
         : output(os) {}
+
+    void log(std::string_view message) override {
+        std::lock_guard l { guard };
+        output << message << std::endl;
+    }
 };
 
+// Every producer thread appends messages to its own buffer, so producers don't block each other.
+// Messages are stamped with global ticket, the writer merges buffers by tickets and writes out
+// only continuous sequence of them, so order of messages is the same as order of log calls.
+// The ticket counter is the only cache line shared by producers; it's kept in favour of
+// per-thread sequences merged by timestamps, since those lose order of concurrent calls
+// and flush would have to wait for target of every buffer
+struct Logger::AsyncImpl : Logger::Impl {
+
+    struct Entry {
+        uint64_t ticket;
+        size_t offset;
+        size_t size;
+    };
+
+    struct Buffer {
+        std::mutex guard; // contended only by writer
+        std::string data;
+        std::vector<Entry> entries;
+        bool owned { true }; // thread of buffer hasn't exited, changed under guard
+    };
+
+    // data swapped out of buffer; it's freed once all its messages are written out
+    struct Chunk {
+        std::string data;
+        size_t nunwritten {};
+    };
+
+    // message which has been taken from buffer but isn't written yet
+    struct Pending {
+        uint64_t ticket;
+        std::string_view message;
+        Chunk* chunk;
+    };
+
+    std::ostream& output;
+    const AsyncOptions options;
+    const uint64_t id;
+    std::atomic<uint64_t> next_ticket {};
+    std::atomic<bool> overflowed { false }; // a buffer has reached flush_bytes
+
+    std::mutex guard;
+    // buffer is shared by logger and cache of its thread, so either of them may go first
+    std::vector<std::shared_ptr<Buffer>> buffers;
+    std::condition_variable cv_writer;
+    std::condition_variable cv_written;
+    uint64_t written {}; // all messages with less tickets are written out
+    uint64_t flush_target {};
+    bool stopped { false };
+
+    std::thread writer;
+
+    AsyncImpl(std::ostream& os, AsyncOptions opts)
+        : output(os)
+        , options(opts)
+        , id(next_id())
+        , writer(&AsyncImpl::run, this) {}
+
+    ~AsyncImpl() {
+        {
+            std::lock_guard l { guard };
+            stopped = true;
+        }
+        cv_writer.notify_one();
+        writer.join();
+    }
+
+    static uint64_t next_id() {
+        static std::atomic<uint64_t> counter {};
+        return counter++;
+    }
+
+    Buffer& thread_buffer();
+
+    void log(std::string_view message) override;
+    void flush() override;
+
+    void run();
+    void write_out(std::vector<Pending>& pending);
+};
+
+auto Logger::AsyncImpl::thread_buffer() -> Buffer& {
+    // loggers are identified by id, since address of destroyed logger may be reused
+    struct Cached {
+        uint64_t id;
+        std::shared_ptr<Buffer> buffer;
+    };
+    // buffers of exited thread are released by writer once they are written out
+    struct Cache {
+        std::vector<Cached> entries;
+
+        ~Cache() {
+            for (auto& c : entries) {
+                std::lock_guard l { c.buffer->guard };
+                c.buffer->owned = false;
+            }
+        }
+    };
+    thread_local Cache cache;
+
+    for (auto& c : cache.entries)
+        if (c.id == id)
+            return *c.buffer;
+
+    // buffers of destroyed loggers aren't referred by them anymore
+    auto& entries = cache.entries;
+    entries.erase(std::remove_if(entries.begin(), entries.end(), [] (const Cached& c) {
+        return c.buffer.use_count() == 1;
+    }), entries.end());
+
+    auto buffer = std::make_shared<Buffer>();
+    {
+        std::lock_guard l { guard };
+        buffers.push_back(buffer);
+    }
+    auto& ret = *buffer;
+    entries.push_back({ id, std::move(buffer) });
+    return ret;
+}
+
+void Logger::AsyncImpl::log(std::string_view message) {
+    auto& buffer = thread_buffer();
+
+    bool overflow;
+    {
+        std::lock_guard l { buffer.guard };
+        // ticket is taken under lock of buffer, so entries of every buffer are ordered by tickets
+        buffer.entries.push_back({ next_ticket++, buffer.data.size(), message.size() });
+        buffer.data.append(message.data(), message.size());
+        overflow = buffer.data.size() >= options.flush_bytes;
+    }
+
+    // writer is woken once per round; notification under guard isn't lost by writer going to sleep
+    if (overflow && !overflowed.exchange(true)) {
+        {
+            std::lock_guard l { guard };
+        }
+        cv_writer.notify_one();
+    }
+}
+
+void Logger::AsyncImpl::flush() {
+    std::unique_lock l { guard };
+    const auto target = next_ticket.load();
+    flush_target = std::max(flush_target, target);
+    cv_writer.notify_one();
+    cv_written.wait(l, [this, target] {
+        return written >= target;
+    });
+}
+
+void Logger::AsyncImpl::run() {
+    std::vector<std::unique_ptr<Chunk>> chunks;
+    std::unique_ptr<Chunk> spare;
+    std::vector<Pending> pending;
+    std::vector<Entry> entries;
+    std::vector<Buffer*> snapshot;
+    std::vector<Buffer*> released;
+
+    std::unique_lock l { guard };
+    for (;;) {
+        cv_writer.wait_for(l, options.flush_interval, [this] {
+            return stopped || flush_target > written || overflowed.load();
+        });
+        const auto exit = stopped;
+        // buffers overflowing after this point wake the writer for the next round
+        overflowed.store(false);
+
+        // buffers of threads are swapped out one by one without holding others
+        snapshot.clear();
+        for (auto& buffer : buffers)
+            snapshot.push_back(buffer.get());
+        l.unlock();
+
+        for (auto buffer : snapshot) {
+            if (!spare)
+                spare = std::make_unique<Chunk>();
+            {
+                std::lock_guard bl { buffer->guard };
+                if (buffer->entries.empty()) {
+                    // nothing is going to be appended to buffer of exited thread
+                    if (!buffer->owned)
+                        released.push_back(buffer);
+                    continue;
+                }
+                std::swap(buffer->data, spare->data);
+                std::swap(buffer->entries, entries);
+            }
+            auto& chunk = chunks.emplace_back(std::move(spare));
+            chunk->nunwritten = entries.size();
+            const std::string_view data { chunk->data };
+            for (auto& e : entries)
+                pending.push_back({ e.ticket, data.substr(e.offset, e.size), chunk.get() });
+            entries.clear();
+        }
+
+        write_out(pending);
+        chunks.erase(std::remove_if(chunks.begin(), chunks.end(), [] (const auto& chunk) {
+            return chunk->nunwritten == 0;
+        }), chunks.end());
+
+        l.lock();
+        if (!released.empty()) {
+            buffers.erase(std::remove_if(buffers.begin(), buffers.end(), [&released] (const auto& buffer) {
+                return std::find(released.begin(), released.end(), buffer.get()) != released.end();
+            }), buffers.end());
+            released.clear();
+        }
+        cv_written.notify_all();
+        // logger isn't used anymore when it's stopped, so no more tickets are going to be taken
+        if (exit && written == next_ticket.load())
+            return;
+    }
+}
+
+void Logger::AsyncImpl::write_out(std::vector<Pending>& pending) {
+    std::sort(pending.begin(), pending.end(), [] (const Pending& lhs, const Pending& rhs) {
+        return lhs.ticket < rhs.ticket;
+    });
+
+    // message may be still missing if its ticket has been taken after snapshot of its buffer;
+    // messages following the gap wait for the next round
+    auto next = written;
+    auto it = pending.begin();
+    for (; it != pending.end() && it->ticket == next; ++it, ++next) {
+        output.write(it->message.data(), it->message.size());
+        output.put('\n');
+        --it->chunk->nunwritten;
+    }
+    output.flush();
+    pending.erase(pending.begin(), it);
+
+    std::lock_guard l { guard };
+    written = next;
+}
+
 Logger::Logger(std::ostream& output) 
-    : priv_(std::make_shared<Impl>(output)) {}
+    : priv_(std::make_shared<SyncImpl>(output)) {}
+
+Logger::Logger(std::ostream& output, AsyncOptions options) 
+    : priv_(std::make_shared<AsyncImpl>(output, options)) {}
 
 void Logger::log(std::string_view message) const {
-    std::lock_guard l { priv_->guard };
-    priv_->output << message << std::endl;
+    priv_->log(message);
+}
+
+void Logger::flush() const {
+    priv_->flush();
 }
 
-} // namespace griha
\ No newline at end of file
+} // namespace griha
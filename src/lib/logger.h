@@ -1,5 +1,6 @@
 #pragma once
 
+#include <chrono>
 #include <memory>
 #include <iostream>
 #include <string_view>
@@ -9,14 +10,27 @@ namespace griha {
 class Logger {
 
     struct Impl;
+    struct SyncImpl;
+    struct AsyncImpl;
+
+public:
+    // messages are buffered per calling thread and written out by background thread
+    struct AsyncOptions {
+        std::chrono::milliseconds flush_interval { 10 };
+        size_t flush_bytes { 64 * 1024 }; // buffer of a thread wakes up writer when it exceeds
+    };
 
 public:
     explicit Logger(std::ostream& output = std::cout);
+    Logger(std::ostream& output, AsyncOptions options);
 
     void log(std::string_view message) const;
 
+    // waits until all messages logged before are written out
+    void flush() const;
+
 private:
     std::shared_ptr<Impl> priv_;
 };
 
-} // namespace griha
\ No newline at end of file
+} // namespace griha
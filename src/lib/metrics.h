@@ -0,0 +1,34 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include "histogram.h"
+
+namespace griha {
+
+// Counter updated by single thread at a time and readable from any thread.
+// Relaxed load and store are used instead of read-modify-write, so update costs plain increment
+class Counter {
+
+public:
+    Counter() = default;
+
+    Counter(const Counter&) = delete;
+    Counter& operator= (const Counter&) = delete;
+
+    void add(uint64_t n) {
+        value_.store(value_.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+    Counter& operator++ () {
+        add(1);
+        return *this;
+    }
+
+    uint64_t get() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> value_ {};
+};
+
+} // namespace griha
@@ -0,0 +1,168 @@
+#include "mmap_file_sink.h"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "metrics.h"
+
+namespace griha {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const size_t c_page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+
+struct Writer {
+    size_t index;
+    const MmapFileSink::Options* options;
+    int fd { -1 };
+    char* mapping { nullptr };
+    size_t capacity {};
+    size_t size {};     // data written into segment
+    size_t synced {};   // data synced to disk
+    size_t nrecords {};
+    size_t nunsynced {}; // records in unsynced data
+    Counter nlost;
+    Clock::time_point last_sync { Clock::now() };
+
+    ~Writer() {
+        close();
+    }
+
+    // segment is large enough for the record even if it exceeds segment size
+    bool open(size_t min_capacity) {
+        const auto filename = "mapped_" + std::to_string(record::now_ns()) + '_' + std::to_string(index) + ".log";
+        fd = ::open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd == -1)
+            return false;
+        size = synced = 0;
+
+        capacity = std::max(options->segment_bytes, min_capacity);
+        capacity = (capacity + c_page_size - 1) / c_page_size * c_page_size;
+
+        // blocks are allocated beforehand, so writing into mapping doesn't fail on full disk;
+        // file system without fallocate gets sparse file
+        auto ptr = posix_fallocate(fd, 0, capacity) == 0 || ftruncate(fd, capacity) == 0
+            ? mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)
+            : MAP_FAILED;
+        if (ptr == MAP_FAILED) {
+            // empty segment isn't left behind
+            close();
+            ::unlink(filename.c_str());
+            return false;
+        }
+
+        mapping = static_cast<char*>(ptr);
+        return true;
+    }
+
+    void close() {
+        if (mapping != nullptr) {
+            sync();
+            munmap(mapping, capacity);
+            mapping = nullptr;
+        }
+
+        if (fd != -1) {
+            // unused preallocated tail is cut off
+            if (ftruncate(fd, size) == 0)
+                fdatasync(fd);
+            ::close(fd);
+            fd = -1;
+        }
+    }
+
+    void sync() {
+        last_sync = Clock::now();
+        if (mapping == nullptr || synced == size)
+            return;
+
+        // msync requires page-aligned start; records failed to be written back are lost
+        const auto begin = synced / c_page_size * c_page_size;
+        if (msync(mapping + begin, size - begin, MS_SYNC) != 0)
+            nlost.add(nunsynced);
+        synced = size;
+        nunsynced = 0;
+    }
+
+    // returns pointer to the place of record of given size
+    char* reserve(size_t record_size) {
+        if (mapping != nullptr && capacity - size < record_size)
+            close();
+        if (mapping == nullptr && !open(record_size))
+            return nullptr;
+
+        auto ret = mapping + size;
+        size += record_size;
+        ++nunsynced;
+        return ret;
+    }
+};
+
+} // unnamed namespace
+
+struct MmapFileSink::Impl {
+    const Options options;
+    PerThreadWriters<Writer> writers;
+
+    Impl(size_t nthreads, Options opts)
+        : options(opts)
+        , writers(nthreads, [this] (Writer& writer, size_t index) {
+            writer.index = index;
+            writer.options = &options;
+        }) {}
+};
+
+MmapFileSink::MmapFileSink(size_t nthreads, Options options)
+    : priv_(std::make_unique<Impl>(nthreads, options)) {}
+
+MmapFileSink::~MmapFileSink() = default;
+
+size_t MmapFileSink::write(std::string_view name, const Bulk& bulk, size_t index) {
+    return priv_->writers.with(index, [&] (Writer& writer) -> size_t {
+        std::string header;
+        record::append_header(header, name, bulk, record::now_ns(), index, writer.nrecords++);
+
+        // size is known beforehand, so statements are copied from arena of bulk straight into mapping
+        const auto record_size = header.size() + record::statements_size(bulk);
+        auto out = writer.reserve(record_size);
+        if (out == nullptr)
+            return c_lost;
+
+        std::memcpy(out, header.data(), header.size());
+        record::copy_statements(out + header.size(), bulk);
+
+        const auto& options = priv_->options;
+        if (writer.size - writer.synced >= options.sync_bytes || Clock::now() - writer.last_sync >= options.sync_interval)
+            writer.sync();
+
+        return record_size;
+    });
+}
+
+void MmapFileSink::flush() {
+    priv_->writers.for_each([] (Writer& writer) { writer.sync(); });
+}
+
+void MmapFileSink::flush_expired() {
+    const auto now = Clock::now();
+    const auto& options = priv_->options;
+    priv_->writers.for_each([now, &options] (Writer& writer) {
+        if (now - writer.last_sync >= options.sync_interval)
+            writer.sync();
+    });
+}
+
+uint64_t MmapFileSink::nlost() const {
+    uint64_t ret = 0;
+    priv_->writers.peek([&ret] (const Writer& writer) { ret += writer.nlost.get(); });
+    return ret;
+}
+
+} // namespace griha
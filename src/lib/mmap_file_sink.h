@@ -0,0 +1,48 @@
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <string_view>
+
+#include "file_sink.h"
+
+namespace griha {
+
+// Sink writing bulks of all connections into preallocated memory-mapped segment files,
+// one segment per executor thread at a time. Records are the same as of BatchedFileSink
+// and are copied from bulks straight into the mapping; written range is synced to disk
+// when it exceeds sync_bytes or sync_interval passes, so data loss on a crash is bounded.
+// Segment is truncated to its data when it's closed; after a crash unused tail is zero-filled
+class MmapFileSink : public FileSink {
+
+    struct Impl;
+
+public:
+    struct Options {
+        size_t segment_bytes { 64 * 1024 * 1024 }; // preallocated size of a segment
+        size_t sync_bytes { 1024 * 1024 }; // unsynced data is synced when it exceeds
+        std::chrono::milliseconds sync_interval { 100 }; // checked at every write and by flush_expired
+    };
+
+public:
+    MmapFileSink(size_t nthreads, Options options);
+    ~MmapFileSink();
+
+    MmapFileSink(const MmapFileSink&) = delete;
+    MmapFileSink& operator= (const MmapFileSink&) = delete;
+
+    // writers of different threads never contend
+    size_t write(std::string_view name, const Bulk& bulk, size_t index) override;
+
+    // syncs written data of all threads
+    void flush() override;
+    void flush_expired() override;
+
+    uint64_t nlost() const override;
+    bool buffered() const override { return true; }
+
+private:
+    std::unique_ptr<Impl> priv_;
+};
+
+} // namespace griha
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+#include "pow2.h"
+
+namespace griha {
+
+// Bounded lock-free multi-producer multi-consumer queue.
+// Every cell carries sequence number telling whether it's ready to be written or read,
+// so producers and consumers contend only on their own position counter
+template <typename T>
+class MpmcQueue {
+
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+public:
+    // capacity is rounded up to power of two
+    explicit MpmcQueue(size_t capacity);
+
+    MpmcQueue(const MpmcQueue&) = delete;
+    MpmcQueue& operator= (const MpmcQueue&) = delete;
+
+    // value is left untouched if queue is full
+    bool try_push(T& value);
+    bool try_pop(T& value);
+
+    bool empty() const;
+    // approximate under concurrent access
+    size_t size() const;
+    size_t capacity() const { return mask_ + 1; }
+
+private:
+    std::unique_ptr<Cell[]> cells_;
+    const size_t mask_;
+    alignas(64) std::atomic<size_t> enqueue_pos_ {};
+    alignas(64) std::atomic<size_t> dequeue_pos_ {};
+};
+
+template <typename T>
+MpmcQueue<T>::MpmcQueue(size_t capacity)
+    : cells_(std::make_unique<Cell[]>(details::round_up_pow2(capacity)))
+    , mask_(details::round_up_pow2(capacity) - 1) {
+    for (size_t i = 0; i <= mask_; ++i)
+        cells_[i].sequence.store(i, std::memory_order_relaxed);
+}
+
+template <typename T>
+bool MpmcQueue<T>::try_push(T& value) {
+    auto pos = enqueue_pos_.load(std::memory_order_relaxed);
+    for (;;) {
+        auto& cell = cells_[pos & mask_];
+        const auto seq = cell.sequence.load(std::memory_order_acquire);
+        const auto diff = static_cast<std::ptrdiff_t>(seq - pos);
+        if (diff == 0) {
+            if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                cell.value = std::move(value);
+                cell.sequence.store(pos + 1, std::memory_order_release);
+                return true;
+            }
+        } else if (diff < 0) {
+            return false; // full
+        } else {
+            pos = enqueue_pos_.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+template <typename T>
+bool MpmcQueue<T>::try_pop(T& value) {
+    auto pos = dequeue_pos_.load(std::memory_order_relaxed);
+    for (;;) {
+        auto& cell = cells_[pos & mask_];
+        const auto seq = cell.sequence.load(std::memory_order_acquire);
+        const auto diff = static_cast<std::ptrdiff_t>(seq - (pos + 1));
+        if (diff == 0) {
+            if (dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                value = std::move(cell.value);
+                cell.sequence.store(pos + mask_ + 1, std::memory_order_release);
+                return true;
+            }
+        } else if (diff < 0) {
+            return false; // empty
+        } else {
+            pos = dequeue_pos_.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+template <typename T>
+bool MpmcQueue<T>::empty() const {
+    const auto pos = dequeue_pos_.load(std::memory_order_relaxed);
+    const auto seq = cells_[pos & mask_].sequence.load(std::memory_order_acquire);
+    return static_cast<std::ptrdiff_t>(seq - (pos + 1)) < 0;
+}
+
+template <typename T>
+size_t MpmcQueue<T>::size() const {
+    const auto tail = dequeue_pos_.load(std::memory_order_relaxed);
+    const auto head = enqueue_pos_.load(std::memory_order_relaxed);
+    return head > tail ? head - tail : 0;
+}
+
+} // namespace griha
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstddef>
+
+namespace griha::details {
+
+// the least power of two not less than value; it's two at least
+inline size_t round_up_pow2(size_t value) {
+    size_t ret = 2;
+    while (ret < value)
+        ret <<= 1;
+    return ret;
+}
+
+} // namespace griha::details
@@ -4,127 +4,120 @@
 #include <string>
 #include <string_view>
 
+#include "bulk.h"
+#include "metrics.h"
 #include "reader_subscriber.h"
+#include "statement_container.h"
 #include "statement_factory.h"
 
 namespace griha {
 
-namespace {
-
-using namespace std::string_view_literals;
-
-constexpr auto c_explicit_block_begin   = "{"sv;
-constexpr auto c_explicit_block_end     = "}"sv;
-
-bool is_block_begin(std::string_view line) {
-    using namespace std;
-    return line == c_explicit_block_begin;
-}
-
-bool is_block_end(std::string_view line) {
-    using namespace std;
-    return line == c_explicit_block_end;
-}
-
-} // unnamed namespace
+struct ReaderImpl {
 
-struct ReaderState : std::enable_shared_from_this<ReaderState> {
-    virtual ~ReaderState() {}
-    virtual void process(std::string) = 0;
-    virtual void on_eof() {}
-};
-using ReaderStatePtr = std::shared_ptr<ReaderState>;
+    // states are kept inline, so transitions neither allocate nor need RTTI
+    enum class State {
+        initial,    // statements are grouped by block size
+        block,      // inside of explicit (possibly nested) block
+        error       // syntax error; input is ignored until end
+    };
 
-struct ReaderImpl {
+    inline ReaderImpl(size_t bsize, Reader::Limits lims, StatementFactory::Options stm_options)
+        : block_size(bsize)
+        , limits(lims)
+        , statement_factory(stm_options) {}
 
-    inline ReaderImpl(size_t bsize)
-        : state(nullptr)
-        , block_size(bsize) {}
+    State state { State::initial };
+    size_t count {};            // statements in current block of initial state
+    size_t level {};            // nesting level of explicit block
+    std::string_view error;     // description of syntax error
 
-    ReaderStatePtr state;
     const size_t block_size;
+    const Reader::Limits limits;
+    size_t nbytes {};                   // size of statements in current block
+    Reader::Clock::time_point started;  // time of the first statement of current block
 
     std::vector<ReaderSubscriberPtr> subscribers;
 
     StatementFactory statement_factory;
     StatementContainer statements;
 
-    Reader::Metrics metrics;
+    // counters are written by producer only but can be read at any time
+    struct Counters {
+        Counter nlines;
+        Counter nstatements;
+        Counter nblocks;
+        Counter nflushed_by_size;
+        Counter nflushed_by_age;
+    } metrics;
+    Histogram close_latency; // from the first statement of block to its publishing
 
-    template <typename State> State& change_state(); 
+    void change_state(State new_state);
 
-    void parse(std::string line);
+    void parse(std::string_view line);
 
-    void process(std::string line);
+    void process(std::string_view line, LineKind kind);
+    void process_initial(std::string_view line, LineKind kind);
+    void process_block(std::string_view line, LineKind kind);
     void on_eof();
 
+    std::optional<Reader::Clock::time_point> expires_at() const;
+    void on_timer(Reader::Clock::time_point now);
+
     void notify_block();
     void notify_unexpected_eof();
 };
 
-struct InitialState : ReaderState {
-    inline explicit InitialState(ReaderImpl& r_impl)
-        : reader_impl(r_impl) {}
-
-    void process(std::string line) override;
-    void on_eof() override;
-
-    ReaderImpl& reader_impl;
-    size_t count {};
-};
-
-struct BlockState : ReaderState {
-    inline BlockState(ReaderImpl& r_impl) 
-        : reader_impl(r_impl) {}
-
-    void process(std::string line) override;
-    void on_eof() override;
-
-    ReaderImpl& reader_impl;
-    size_t level { 1 };
-};
-
-struct ErrorState : ReaderState {
-    inline ErrorState(ReaderImpl& r_impl)
-        : reader_impl(r_impl) {}
-
-    void process(std::string line) override;
-
-    ReaderImpl& reader_impl;
-    std::string error;
-};
-
-template <typename State>
-State& ReaderImpl::change_state() {
-    // for further optimization it looks pretty to create states pool
-    state = std::make_shared<State>(*this);
-    return dynamic_cast<State&>(*state);
-} 
+void ReaderImpl::change_state(State new_state) {
+    state = new_state;
+    count = 0;
+    level = new_state == State::block ? 1 : 0;
+}
 
-void ReaderImpl::parse(std::string line) {
+void ReaderImpl::parse(std::string_view line) {
     ++metrics.nstatements;
-    statements.push_back(statement_factory.create(std::move(line)));
+    if (statements.empty())
+        started = Reader::Clock::now();
+
+    nbytes += line.size();
+    // the only place line is copied - its text is stored in arena of current block
+    // unless it's interned by statement factory
+    statements.push_back(statement_factory.create(line, statements));
 }
 
-void ReaderImpl::process(std::string line) {
+void ReaderImpl::process(std::string_view line, LineKind kind) {
     ++metrics.nlines;
-    auto save_state_ptr = state->shared_from_this(); // protect against unexpected deletion
-    return state->process(std::move(line));
+    switch (state) {
+        case State::initial: process_initial(line, kind); break;
+        case State::block: process_block(line, kind); break;
+        case State::error: break; // do nothing
+    }
 }
 
 void ReaderImpl::on_eof() {
-    state->on_eof();
+    switch (state) {
+        case State::initial: notify_block(); break;
+        case State::block: notify_unexpected_eof(); break;
+        case State::error: break;
+    }
 }
 
 void ReaderImpl::notify_block() {
     if (statements.empty())
         return; // empty block doesn't require notification
 
+    const auto seq = metrics.nblocks.get();
     ++metrics.nblocks;
+    nbytes = 0;
 
-    for (auto& subscriber : subscribers)
-        subscriber->on_block(statements);
+    const auto closed = Reader::Clock::now();
+    close_latency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(closed - started).count());
+
+    // block is published once and shared by all subscribers
+    const BulkPtr bulk = std::make_shared<Bulk>(Bulk { std::move(statements), closed, seq });
     statements.clear();
+
+    for (auto& subscriber : subscribers)
+        subscriber->on_block(bulk);
 }
 
 void ReaderImpl::notify_unexpected_eof() {
@@ -135,59 +128,70 @@ void ReaderImpl::notify_unexpected_eof() {
         subscriber->on_unexpected_eof(statements);
 }
 
-void InitialState::process(std::string line) {
+void ReaderImpl::process_initial(std::string_view line, LineKind kind) {
     using namespace std;
 
-    if (is_block_end(line)) {
-        reader_impl.change_state<ErrorState>().error = "unexpected end of block"s;
-    } else if (is_block_begin(line)) {
+    if (kind == LineKind::block_end) {
+        change_state(State::error);
+        error = "unexpected end of block"sv;
+    } else if (kind == LineKind::block_begin) {
         // in initial state start of explicit block triggers end of block
-        reader_impl.notify_block();
-        reader_impl.change_state<BlockState>();
+        notify_block();
+        change_state(State::block);
     } else {
-        reader_impl.parse(std::move(line));
-        if (++count == reader_impl.block_size) {
+        parse(line);
+        if (++count == block_size) {
             // fixed block size has been reached
-            reader_impl.notify_block();
+            notify_block();
+            count = 0;
+        } else if (limits.max_bulk_bytes != 0 && nbytes >= limits.max_bulk_bytes) {
+            ++metrics.nflushed_by_size;
+            notify_block();
             count = 0;
         }
     }
 }
 
-void InitialState::on_eof() {
-    reader_impl.notify_block();
+std::optional<Reader::Clock::time_point> ReaderImpl::expires_at() const {
+    if (limits.max_bulk_age.count() == 0 || state != State::initial || statements.empty())
+        return std::nullopt;
+    return started + limits.max_bulk_age;
 }
 
-void BlockState::process(std::string line) {
-    using namespace std;
+void ReaderImpl::on_timer(Reader::Clock::time_point now) {
+    const auto deadline = expires_at();
+    if (!deadline || *deadline > now)
+        return;
 
-    if (is_block_begin(line)) {
+    ++metrics.nflushed_by_age;
+    notify_block();
+    count = 0;
+}
+
+void ReaderImpl::process_block(std::string_view line, LineKind kind) {
+    if (kind == LineKind::block_begin) {
         // nested explicit blocks are ignored but correction of syntax is required
         ++level;
-    } else if (is_block_end(line)) {
+    } else if (kind == LineKind::block_end) {
         if (--level == 0) {
             // explicit block has been ended
             // block has statements - notify about end of block
-            reader_impl.notify_block();
-            reader_impl.change_state<InitialState>();
+            notify_block();
+            change_state(State::initial);
         }
     } else {
-        reader_impl.parse(std::move(line));
+        parse(line);
     }
 }
 
-void BlockState::on_eof() {
-    reader_impl.notify_unexpected_eof();
-}
+Reader::Reader(size_t block_size)
+    : Reader(block_size, Limits {}) {}
 
-void ErrorState::process([[maybe_unused]] std::string line) {
-    // do nothing
-}
+Reader::Reader(size_t block_size, Limits limits)
+    : Reader(block_size, limits, StatementFactory::Options {}) {}
 
-Reader::Reader(size_t block_size) 
-    : priv_(std::make_unique<ReaderImpl>(block_size)) {
-    priv_->change_state<InitialState>();
-}
+Reader::Reader(size_t block_size, Limits limits, StatementFactory::Options statements)
+    : priv_(std::make_unique<ReaderImpl>(block_size, limits, statements)) {}
 
 Reader::~Reader() = default;
 Reader::Reader(Reader&&) = default;
@@ -200,12 +204,36 @@ void Reader::subscribe(ReaderSubscriberPtr subscriber) {
         subscribers.push_back(std::move(subscriber));
 }
 
-void Reader::consume(std::string line) {
-    priv_->process(std::move(line));
+void Reader::consume(std::string_view line) {
+    priv_->process(line, classify_line(line));
+}
+
+void Reader::consume(const Line* lines, size_t nlines) {
+    auto& impl = *priv_;
+    for (auto it = lines, last = lines + nlines; it != last; ++it)
+        impl.process(it->text, it->kind);
+}
+
+auto Reader::get_metrics() const -> Metrics {
+    auto& counters = priv_->metrics;
+    return Metrics {
+        counters.nlines.get(),
+        counters.nstatements.get(),
+        counters.nblocks.get(),
+        counters.nflushed_by_size.get(),
+        counters.nflushed_by_age.get(),
+        priv_->statement_factory.nhits(),
+        priv_->statement_factory.nmisses(),
+        priv_->close_latency.snapshot()
+    };
+}
+
+auto Reader::expires_at() const -> std::optional<Clock::time_point> {
+    return priv_->expires_at();
 }
 
-auto Reader::get_metrics() const -> const Metrics& {
-    return priv_->metrics;
+void Reader::on_timer(Clock::time_point now) {
+    priv_->on_timer(now);
 }
 
 void Reader::on_eof() {
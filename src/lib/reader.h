@@ -1,22 +1,42 @@
 #pragma once
 
-#include <string>
+#include <chrono>
 #include <memory>
+#include <optional>
+#include <string_view>
 
 #include "forward.h"
+#include "line_scanner.h"
+#include "metrics.h"
+#include "statement_factory.h"
 
 namespace griha {
 
 class Reader {
 public:
+    using Clock = std::chrono::steady_clock;
+
+    // additional triggers closing dynamic blocks; explicit blocks aren't affected
+    struct Limits {
+        size_t max_bulk_bytes;                      // zero means unlimited
+        std::chrono::milliseconds max_bulk_age;     // zero means unlimited
+    };
+
     struct Metrics {
         size_t nlines;
         size_t nstatements;
         size_t nblocks;
+        size_t nflushed_by_size;
+        size_t nflushed_by_age;
+        size_t ncache_hits;     // statements found in cache of statement factory
+        size_t ncache_misses;   // statements added to it
+        Histogram::Snapshot close_latency; // nanoseconds from the first statement to publishing of block
     };
 
 public:
     Reader(size_t block_size);
+    Reader(size_t block_size, Limits limits);
+    Reader(size_t block_size, Limits limits, StatementFactory::Options statements);
     ~Reader();
 
     Reader(Reader&&);
@@ -28,8 +48,17 @@ public:
 
     void subscribe(ReaderSubscriberPtr subscriber);
 
-    void consume(std::string line);
-    const Metrics& get_metrics() const;
+    // line isn't required to outlive the call
+    void consume(std::string_view line);
+    // lines are handled in order as if they were consumed one by one
+    void consume(const Line* lines, size_t nlines);
+    // snapshot is consistent per counter only; it may be taken concurrently with consume
+    Metrics get_metrics() const;
+
+    // time when current dynamic block exceeds its maximum age, if it's limited
+    std::optional<Clock::time_point> expires_at() const;
+    // closes current dynamic block if it's expired by now
+    void on_timer(Clock::time_point now);
 
     void on_eof();
 
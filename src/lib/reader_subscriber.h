@@ -6,7 +6,7 @@ namespace griha {
 
 struct ReaderSubscriber {
     virtual ~ReaderSubscriber() {}
-    virtual void on_block(const StatementContainer&) = 0;
+    virtual void on_block(const BulkPtr&) = 0;
     virtual void on_unexpected_eof(const StatementContainer&) {}
 };
 
@@ -0,0 +1,185 @@
+#include "segment_file_sink.h"
+
+#include <string>
+#include <vector>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <zstd.h>
+
+#include "bulk.h"
+#include "metrics.h"
+#include "segment_format.h"
+
+namespace griha {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+bool write_all(int fd, const void* data, size_t size) {
+    auto ptr = static_cast<const char*>(data);
+    while (size != 0) {
+        const auto n = ::write(fd, ptr, size);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        ptr += n;
+        size -= n;
+    }
+    return true;
+}
+
+struct Writer {
+    size_t index;
+    const SegmentFileSink::Options* options;
+    ZSTD_CCtx* cctx { ZSTD_createCCtx() }; // reused for all blocks of the thread
+    int fd { -1 };
+    int index_fd { -1 };
+    std::string block; // raw records of current block
+    std::vector<segment::IndexEntry> entries; // index of records of current block
+    std::string compressed;
+    uint64_t segment_size {};
+    size_t nrecords {};
+    Counter nlost;
+    Clock::time_point last_flush { Clock::now() };
+
+    ~Writer() {
+        flush();
+        close();
+        ZSTD_freeCCtx(cctx);
+    }
+
+    void open() {
+        const auto basename = "bulks_" + std::to_string(record::now_ns()) + '_' + std::to_string(index);
+        fd = ::open((basename + ".seg").c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        index_fd = ::open((basename + ".idx").c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd == -1 || index_fd == -1) {
+            close();
+            return;
+        }
+
+        if (!write_all(fd, segment::c_segment_magic, sizeof(segment::c_segment_magic))
+                || !write_all(index_fd, segment::c_index_magic, sizeof(segment::c_index_magic))) {
+            close();
+            return;
+        }
+        segment_size = sizeof(segment::c_segment_magic);
+    }
+
+    bool write_block(size_t size) {
+        if (fd == -1)
+            return false;
+
+        const segment::BlockHeader header {
+            static_cast<uint32_t>(size),
+            static_cast<uint32_t>(block.size())
+        };
+        for (auto& entry : entries)
+            entry.block_offset = segment_size;
+
+        return write_all(fd, &header, sizeof(header))
+            && write_all(fd, compressed.data(), size)
+            && write_all(index_fd, entries.data(), entries.size() * sizeof(segment::IndexEntry));
+    }
+
+    void close() {
+        if (fd != -1)
+            ::close(fd);
+        if (index_fd != -1)
+            ::close(index_fd);
+        fd = index_fd = -1;
+    }
+
+    void flush() {
+        last_flush = Clock::now();
+        if (block.empty())
+            return;
+
+        if (fd == -1)
+            open();
+
+        compressed.resize(ZSTD_compressBound(block.size()));
+        const auto size = ZSTD_compressCCtx(cctx, compressed.data(), compressed.size(),
+            block.data(), block.size(), options->level);
+
+        if (!ZSTD_isError(size) && write_block(size)) {
+            segment_size += sizeof(segment::BlockHeader) + size;
+        } else {
+            // records of the block are lost; segment may be broken, so the next block starts a new one
+            nlost.add(entries.size());
+            close();
+        }
+
+        block.clear();
+        entries.clear();
+    }
+};
+
+} // unnamed namespace
+
+struct SegmentFileSink::Impl {
+    const Options options;
+    PerThreadWriters<Writer> writers;
+
+    Impl(size_t nthreads, Options opts)
+        : options(opts)
+        , writers(nthreads, [this] (Writer& writer, size_t index) {
+            writer.index = index;
+            writer.options = &options;
+        }) {}
+};
+
+SegmentFileSink::SegmentFileSink(size_t nthreads, Options options)
+    : priv_(std::make_unique<Impl>(nthreads, options)) {}
+
+SegmentFileSink::~SegmentFileSink() = default;
+
+size_t SegmentFileSink::write(std::string_view name, const Bulk& bulk, size_t index) {
+    return priv_->writers.with(index, [&] (Writer& writer) {
+        const auto time_ns = record::now_ns();
+        auto& block = writer.block;
+        const auto offset = block.size();
+        record::append_header(block, name, bulk, time_ns, index, writer.nrecords++);
+        record::append_statements(block, bulk);
+        const auto nbytes = block.size() - offset;
+
+        // block offset is known when block is written out
+        writer.entries.push_back(segment::IndexEntry { 0, static_cast<uint32_t>(offset),
+            static_cast<uint32_t>(nbytes), time_ns, bulk.seq });
+
+        const auto& options = priv_->options;
+        if (block.size() >= options.block_bytes || Clock::now() - writer.last_flush >= options.flush_interval)
+            writer.flush();
+
+        if (options.segment_bytes != 0 && writer.segment_size >= options.segment_bytes)
+            writer.close();
+
+        return nbytes;
+    });
+}
+
+void SegmentFileSink::flush() {
+    priv_->writers.for_each([] (Writer& writer) { writer.flush(); });
+}
+
+void SegmentFileSink::flush_expired() {
+    const auto now = Clock::now();
+    const auto& options = priv_->options;
+    priv_->writers.for_each([now, &options] (Writer& writer) {
+        if (now - writer.last_flush >= options.flush_interval)
+            writer.flush();
+    });
+}
+
+uint64_t SegmentFileSink::nlost() const {
+    uint64_t ret = 0;
+    priv_->writers.peek([&ret] (const Writer& writer) { ret += writer.nlost.get(); });
+    return ret;
+}
+
+} // namespace griha
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <string_view>
+
+#include "file_sink.h"
+
+namespace griha {
+
+// Sink packing bulks of all connections into segment files compressed by blocks with zstd,
+// one segment per executor thread at a time; layout is described in segment_format.h.
+// Every segment is accompanied by index of its records, so a bulk is found without
+// decompressing the whole segment
+class SegmentFileSink : public FileSink {
+
+    struct Impl;
+
+public:
+    struct Options {
+        size_t block_bytes { 256 * 1024 }; // records are compressed when their raw size exceeds
+        std::chrono::milliseconds flush_interval { 1000 }; // checked at every write and by flush_expired
+        size_t segment_bytes { 256 * 1024 * 1024 }; // new segment is started when it exceeds
+        int level { 3 }; // zstd compression level
+    };
+
+public:
+    SegmentFileSink(size_t nthreads, Options options);
+    ~SegmentFileSink();
+
+    SegmentFileSink(const SegmentFileSink&) = delete;
+    SegmentFileSink& operator= (const SegmentFileSink&) = delete;
+
+    // writers of different threads never contend;
+    // returns raw size of the record, compressed size is known per block only
+    size_t write(std::string_view name, const Bulk& bulk, size_t index) override;
+
+    // compresses and writes out pending records of all threads
+    void flush() override;
+    void flush_expired() override;
+
+    uint64_t nlost() const override;
+    bool buffered() const override { return true; }
+
+private:
+    std::unique_ptr<Impl> priv_;
+};
+
+} // namespace griha
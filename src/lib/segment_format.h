@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+
+namespace griha::segment {
+
+// Layout of files written by SegmentFileSink; integers are in host byte order.
+//
+// Segment file "bulks_<ns>_<thread>.seg":
+//     c_segment_magic, then blocks one after another:
+//     BlockHeader followed by compressed_size bytes of zstd frame holding raw_size bytes of records.
+//     Record is the same text as in batched files, see griha::record in file_sink.h.
+//
+// Index file "bulks_<ns>_<thread>.idx" next to segment:
+//     c_index_magic, then IndexEntry per record in order of writing.
+
+constexpr char c_segment_magic[8] = { 'B', 'U', 'L', 'K', 'S', 'E', 'G', '1' };
+constexpr char c_index_magic[8] = { 'B', 'U', 'L', 'K', 'I', 'D', 'X', '1' };
+
+struct BlockHeader {
+    uint32_t compressed_size;
+    uint32_t raw_size;
+};
+static_assert(sizeof(BlockHeader) == 8);
+
+struct IndexEntry {
+    uint64_t block_offset;  // offset of BlockHeader of the block holding the record
+    uint32_t record_offset; // offset of the record in raw data of the block
+    uint32_t record_size;
+    uint64_t time_ns;       // system time the record was written at
+    uint64_t seq;           // sequence number of bulk within its connection
+};
+static_assert(sizeof(IndexEntry) == 32);
+
+} // namespace griha::segment
@@ -1,9 +0,0 @@
-#include "statement.h"
-
-namespace griha {
-
-void SomeStatement::execute(Executer& ex_ctx) {
-    ex_ctx.execute(*this);
-}
-
-} // namespace griha
\ No newline at end of file
@@ -1,33 +1,26 @@
- #pragma once
+#pragma once
 
-#include <string>
+#include <string_view>
+#include <variant>
 
 #include "forward.h"
 
 namespace griha {
 
-struct Executer;
-struct Statement {
-    virtual ~Statement() {};
-    virtual void execute(Executer&) = 0;
-};
-
-class SomeStatement : public Statement {
+class SomeStatement {
 
 public:
-    explicit SomeStatement(std::string value) : value_(std::move(value)) {}
-
-    void execute(Executer& ex_ctx) override;
+    // value is expected to be stored in arena of statement's block
+    explicit SomeStatement(std::string_view value) : value_(value) {}
 
-    const std::string& value() const { return value_; }
+    std::string_view value() const { return value_; }
 
 private:
-    std::string value_;
-};
-
-struct Executer {
-    virtual void execute(const SomeStatement&) = 0;
+    std::string_view value_;
 };
 
+// Closed set of statement kinds; sinks handle them with std::visit,
+// so every kind has to be known here when it's added to StatementFactory
+using Statement = std::variant<SomeStatement>;
 
-} // namespace griha
\ No newline at end of file
+} // namespace griha
@@ -0,0 +1,34 @@
+#include "statement_arena.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+namespace griha {
+
+void* StatementArena::allocate(size_t size, size_t alignment) {
+    const auto base = reinterpret_cast<uintptr_t>(current_);
+    const auto aligned = (base + offset_ + alignment - 1) & ~(alignment - 1);
+    if (aligned + size <= base + capacity_) {
+        offset_ = aligned + size - base;
+        return reinterpret_cast<void*>(aligned);
+    }
+
+    // chunk memory is aligned for any fundamental type, so padding isn't required
+    capacity_ = std::max(c_chunk_size, size);
+    chunks_.push_back(std::make_unique<char[]>(capacity_));
+    current_ = chunks_.back().get();
+    offset_ = size;
+    return current_;
+}
+
+std::string_view StatementArena::store(std::string_view text) {
+    if (text.empty())
+        return {};
+
+    auto ptr = static_cast<char*>(allocate(text.size(), 1));
+    std::memcpy(ptr, text.data(), text.size());
+    return { ptr, text.size() };
+}
+
+} // namespace griha
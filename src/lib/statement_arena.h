@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace griha {
+
+// Bump allocator keeping statements of a block together.
+// Small blocks fit into storage embedded into arena itself, larger ones take additional chunks.
+// Memory is never returned piecemeal - it's released all at once with arena,
+// so only trivially destructible objects are allowed to be created in arena
+class StatementArena {
+
+    static constexpr size_t c_inline_size = 1024;
+    static constexpr size_t c_chunk_size = 4096;
+
+public:
+    StatementArena() = default;
+
+    StatementArena(const StatementArena&) = delete;
+    StatementArena& operator= (const StatementArena&) = delete;
+
+    void* allocate(size_t size, size_t alignment);
+
+    std::string_view store(std::string_view text);
+
+    template <typename T, typename... Args>
+    T* create(Args&&... args) {
+        static_assert(std::is_trivially_destructible_v<T>, "destructors aren't called by arena");
+        return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+private:
+    alignas(std::max_align_t) char inline_[c_inline_size];
+    std::vector<std::unique_ptr<char[]>> chunks_;
+    char* current_ { inline_ };
+    size_t capacity_ { c_inline_size };
+    size_t offset_ {};
+};
+
+} // namespace griha
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "statement.h"
+#include "statement_arena.h"
+
+namespace griha {
+
+// Statements of a block together with arena they are allocated in
+class StatementContainer {
+
+    using Container = std::vector<Statement>;
+
+public:
+    using value_type = Container::value_type;
+    using const_iterator = Container::const_iterator;
+
+public:
+    StatementContainer() = default;
+
+    StatementContainer(StatementContainer&&) = default;
+    StatementContainer& operator= (StatementContainer&&) = default;
+
+    // arena is created by the first statement stored in it, so block of interned statements has none
+    StatementArena& arena() {
+        if (!arena_)
+            arena_ = std::make_unique<StatementArena>();
+        return *arena_;
+    }
+
+    void push_back(Statement stm) { statements_.push_back(stm); }
+
+    // keeps owner of statements stored outside of arena as long as the block
+    template <typename T>
+    void hold(const std::shared_ptr<T>& owner) {
+        if (owner_.get() == owner.get())
+            return;
+        // owner is changed rarely, so the previous ones don't have to be looked up
+        if (owner_)
+            owners_.push_back(std::move(owner_));
+        owner_ = owner;
+    }
+
+    // starts new block; it's also valid for moved-from container
+    void clear() {
+        statements_.clear();
+        owner_.reset();
+        owners_.clear();
+        arena_.reset();
+    }
+
+    bool empty() const { return statements_.empty(); }
+    size_t size() const { return statements_.size(); }
+
+    const_iterator begin() const { return statements_.begin(); }
+    const_iterator end() const { return statements_.end(); }
+
+private:
+    std::unique_ptr<StatementArena> arena_;
+    Container statements_;
+    std::shared_ptr<const void> owner_; // the latest owner held
+    std::vector<std::shared_ptr<const void>> owners_;
+};
+
+} // namespace griha
@@ -1,11 +1,86 @@
 #include "statement_factory.h"
 
+#include <functional>
+#include <vector>
+
+#include "pow2.h"
 #include "statement.h"
+#include "statement_arena.h"
+#include "statement_container.h"
 
 namespace griha {
 
-StatementPtr StatementFactory::create(std::string line) const {
-    return std::make_shared<SomeStatement>(std::move(line));
+// Open addressing table of texts stored in its arena; it's never more than half full,
+// so probing is short, and entries are never erased - the whole generation is dropped instead
+struct StatementFactory::Generation {
+    struct Slot {
+        size_t hash;
+        std::string_view text; // empty one marks free slot
+    };
+
+    StatementArena arena;
+    std::vector<Slot> slots;
+    const size_t mask;
+    size_t size {};
+
+    explicit Generation(size_t capacity)
+        : slots(details::round_up_pow2(2 * capacity))
+        , mask(slots.size() - 1) {}
+
+    // returns slot of the text or free slot which it's to be stored in
+    Slot& find(std::string_view text, size_t hash) {
+        for (auto i = hash & mask;; i = (i + 1) & mask) {
+            auto& slot = slots[i];
+            if (slot.text.empty() || (slot.hash == hash && slot.text == text))
+                return slot;
+        }
+    }
+};
+
+StatementFactory::StatementFactory()
+    : StatementFactory(Options {}) {}
+
+StatementFactory::StatementFactory(Options options)
+    : options_(options) {}
+
+StatementFactory::~StatementFactory() = default;
+
+Statement StatementFactory::create(std::string_view line, StatementContainer& statements) {
+    if (options_.capacity == 0 || line.empty() || line.size() > options_.max_length)
+        return SomeStatement { statements.arena().store(line) };
+
+    const auto text = intern(line);
+    statements.hold(current_);
+    return SomeStatement { text };
+}
+
+std::string_view StatementFactory::intern(std::string_view line) {
+    const auto hash = std::hash<std::string_view> {}(line);
+    if (current_) {
+        auto& slot = current_->find(line, hash);
+        if (!slot.text.empty()) {
+            ++nhits_;
+            return slot.text;
+        }
+    }
+
+    if (previous_ && !previous_->find(line, hash).text.empty())
+        ++nhits_;
+    else
+        ++nmisses_;
+
+    if (!current_ || current_->size == options_.capacity) {
+        // block referring to evicted generation keeps it until the block is released
+        if (options_.eviction == Eviction::generations)
+            previous_ = std::move(current_);
+        current_ = std::make_shared<Generation>(options_.capacity);
+    }
+
+    // statement of the older generation is copied, so it survives its eviction
+    auto& slot = current_->find(line, hash);
+    slot = { hash, current_->arena.store(line) };
+    ++current_->size;
+    return slot.text;
 }
 
-} // namespace griha
\ No newline at end of file
+} // namespace griha
@@ -1,13 +1,60 @@
 #pragma once
 
-#include <string>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
 
-#include "forward.h"
+#include "metrics.h"
+#include "statement.h"
 
 namespace griha {
 
-struct StatementFactory {
-    StatementPtr create(std::string) const;
+class StatementContainer;
+
+// Creates statements of lines. Optional cache interns text of repeated statements,
+// so it isn't copied into arena of every block; blocks keep interned text alive,
+// so eviction never affects bulks in flight. Cache belongs to producer of connection
+class StatementFactory {
+
+    struct Generation;
+
+public:
+    enum class Eviction {
+        clear,      // full cache is emptied
+        generations // full cache becomes the older generation; its statements are moved
+                    // into the new one once they are met again, so frequent ones survive
+    };
+
+    struct Options {
+        size_t capacity {};         // statements in cache; zero disables it
+        size_t max_length { 256 };  // longer statements aren't cached
+        Eviction eviction { Eviction::generations };
+    };
+
+public:
+    StatementFactory();
+    explicit StatementFactory(Options options);
+    ~StatementFactory();
+
+    StatementFactory(const StatementFactory&) = delete;
+    StatementFactory& operator= (const StatementFactory&) = delete;
+
+    Statement create(std::string_view line, StatementContainer& statements);
+
+    // lookups of cache; they may be read concurrently with create
+    uint64_t nhits() const { return nhits_.get(); }
+    uint64_t nmisses() const { return nmisses_.get(); }
+
+private:
+    std::string_view intern(std::string_view line);
+
+private:
+    const Options options_;
+    std::shared_ptr<Generation> current_;
+    std::shared_ptr<Generation> previous_; // nullptr unless eviction is by generations
+    Counter nhits_;
+    Counter nmisses_;
 };
 
-} // namespace griha
\ No newline at end of file
+} // namespace griha
@@ -0,0 +1,151 @@
+#include "timer_wheel.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace griha {
+
+namespace {
+
+struct Entry {
+    uint64_t id;
+    TimerWheel::Clock::time_point deadline;
+    TimerWheel::Callback callback;
+};
+using Entries = std::vector<Entry>;
+
+bool erase_entry(Entries& entries, uint64_t id) {
+    auto it = std::find_if(entries.begin(), entries.end(), [id] (const Entry& e) { return e.id == id; });
+    if (it == entries.end())
+        return false;
+
+    entries.erase(it);
+    return true;
+}
+
+} // unnamed namespace
+
+struct TimerWheel::Impl {
+
+    const Clock::duration tick;
+    const Clock::time_point origin { Clock::now() };
+    std::vector<Entries> slots;
+    Entries due; // entries taken from slot which are being called
+    std::mutex guard;
+    std::condition_variable cv_timers;
+    std::condition_variable cv_done;
+    uint64_t next_id { 1 };
+    uint64_t running {}; // id of timer which callback is being called
+    size_t ntimers {};
+    uint64_t next_tick {}; // the first tick which slot hasn't been served yet
+    bool stopped { false };
+    std::thread thread;
+
+    Impl(Clock::duration t, size_t nslots)
+        : tick(t)
+        , slots(nslots) {}
+
+    uint64_t tick_of(Clock::time_point time) const {
+        // rounded up, so slot of tick isn't served before deadline
+        return time <= origin ? 0 : (time - origin + tick - Clock::duration { 1 }) / tick;
+    }
+
+    void operator ()();
+    void serve(Entries& slot, Clock::time_point now, std::unique_lock<std::mutex>& l);
+};
+
+void TimerWheel::Impl::operator ()() {
+    std::unique_lock<std::mutex> l { guard };
+    while (!stopped) {
+        if (ntimers == 0) {
+            cv_timers.wait(l);
+            continue;
+        }
+
+        const auto now = Clock::now();
+        const uint64_t now_tick = (now - origin) / tick;
+        if (next_tick > now_tick) {
+            cv_timers.wait_until(l, origin + next_tick * tick);
+            continue;
+        }
+
+        // every slot is served at most once even if wheel has overslept a whole revolution
+        const auto last_tick = std::min(now_tick, next_tick + slots.size() - 1);
+        for (auto t = next_tick; t <= last_tick && !stopped; ++t)
+            serve(slots[t % slots.size()], now, l);
+        next_tick = now_tick + 1;
+    }
+}
+
+void TimerWheel::Impl::serve(Entries& slot, Clock::time_point now, std::unique_lock<std::mutex>& l) {
+    // entries of further revolutions are kept in slot
+    auto it = std::partition(slot.begin(), slot.end(), [now] (const Entry& e) { return e.deadline > now; });
+    due.insert(due.end(), std::make_move_iterator(it), std::make_move_iterator(slot.end()));
+    slot.erase(it, slot.end());
+
+    while (!due.empty()) {
+        auto entry = std::move(due.back());
+        due.pop_back();
+        --ntimers;
+
+        running = entry.id;
+        l.unlock();
+        entry.callback();
+        l.lock();
+        running = 0;
+        cv_done.notify_all();
+    }
+}
+
+TimerWheel::TimerWheel(std::chrono::milliseconds tick, size_t nslots)
+    : priv_(std::make_unique<Impl>(std::max<Clock::duration>(tick, std::chrono::milliseconds { 1 }),
+        std::max<size_t>(nslots, 1))) {
+    priv_->thread = std::thread { std::ref(*priv_) };
+}
+
+TimerWheel::~TimerWheel() {
+    {
+        std::lock_guard<std::mutex> l { priv_->guard };
+        priv_->stopped = true;
+    }
+    priv_->cv_timers.notify_one();
+    priv_->thread.join();
+}
+
+auto TimerWheel::schedule(Clock::time_point deadline, Callback callback) -> Timer {
+    std::unique_lock<std::mutex> l { priv_->guard };
+
+    // deadline which has passed already is served by the nearest tick
+    const auto tick = std::max(priv_->tick_of(deadline), priv_->next_tick);
+    Timer timer { priv_->next_id++, tick % priv_->slots.size() };
+    priv_->slots[timer.slot].push_back(Entry { timer.id, deadline, std::move(callback) });
+
+    // thread of wheel sleeps until the next tick if there are timers,
+    // and no timer is earlier than the next tick, so only idle thread is woken up
+    if (priv_->ntimers++ == 0) {
+        l.unlock();
+        priv_->cv_timers.notify_one();
+    }
+    return timer;
+}
+
+void TimerWheel::cancel(Timer timer) {
+    if (!timer)
+        return;
+
+    std::unique_lock<std::mutex> l { priv_->guard };
+    if (erase_entry(priv_->slots[timer.slot], timer.id) || erase_entry(priv_->due, timer.id)) {
+        --priv_->ntimers;
+        return;
+    }
+
+    if (std::this_thread::get_id() == priv_->thread.get_id())
+        return; // called from callback
+
+    priv_->cv_done.wait(l, [this, &timer] { return priv_->running != timer.id; });
+}
+
+} // namespace griha
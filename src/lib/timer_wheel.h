@@ -0,0 +1,46 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+namespace griha {
+
+// Hashed timer wheel shared by all connections.
+// Timers are put into slots by their deadline tick and served by single thread,
+// which sleeps while there are no timers. Callbacks are executed by that thread,
+// so they delay each other and are expected to be short
+class TimerWheel {
+
+    struct Impl;
+
+public:
+    using Clock = std::chrono::steady_clock;
+    using Callback = std::function<void()>;
+
+    struct Timer {
+        uint64_t id {};
+        size_t slot {};
+
+        explicit operator bool() const { return id != 0; }
+    };
+
+public:
+    TimerWheel(std::chrono::milliseconds tick, size_t nslots);
+    ~TimerWheel();
+
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel& operator= (const TimerWheel&) = delete;
+
+    // callback is called not earlier than deadline and at most one tick later if wheel isn't busy
+    Timer schedule(Clock::time_point deadline, Callback callback);
+    // when it returns callback of timer isn't running and won't be called;
+    // it's allowed to cancel timer from its own callback
+    void cancel(Timer timer);
+
+private:
+    std::unique_ptr<Impl> priv_;
+};
+
+} // namespace griha
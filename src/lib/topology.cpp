@@ -0,0 +1,94 @@
+#include "topology.h"
+
+#include <cctype>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include <dirent.h>
+#include <sched.h>
+
+namespace griha {
+
+namespace {
+
+const std::vector<int> c_no_cpus;
+
+// parses list like "0-3,8,10-11"
+std::vector<int> parse_cpu_list(const std::string& list) {
+    std::vector<int> ret;
+    size_t pos = 0;
+    while (pos < list.size()) {
+        size_t end = 0;
+        const auto first = std::stoi(list.substr(pos), &end);
+        pos += end;
+        auto last = first;
+        if (pos < list.size() && list[pos] == '-') {
+            last = std::stoi(list.substr(++pos), &end);
+            pos += end;
+        }
+        for (auto cpu = first; cpu <= last; ++cpu)
+            ret.push_back(cpu);
+        if (pos < list.size() && list[pos] == ',')
+            ++pos;
+        else
+            break;
+    }
+    return ret;
+}
+
+} // unnamed namespace
+
+Topology::Topology() {
+    if (auto dir = opendir("/sys/devices/system/node")) {
+        while (auto entry = readdir(dir)) {
+            const std::string name = entry->d_name;
+            if (name.compare(0, 4, "node") != 0 || name.size() == 4 || !std::isdigit(name[4]))
+                continue;
+
+            std::ifstream input { "/sys/devices/system/node/" + name + "/cpulist" };
+            std::string list;
+            if (!std::getline(input, list))
+                continue;
+
+            const auto node = std::stoi(name.substr(4));
+            if (node_cpus_.size() <= static_cast<size_t>(node))
+                node_cpus_.resize(node + 1);
+            try {
+                node_cpus_[node] = parse_cpu_list(list);
+            } catch (const std::exception&) {
+                node_cpus_[node].clear(); // malformed list, node is ignored
+            }
+        }
+        closedir(dir);
+    }
+
+    if (node_cpus_.empty()) {
+        node_cpus_.resize(1);
+        for (auto cpu = 0u; cpu < std::thread::hardware_concurrency(); ++cpu)
+            node_cpus_[0].push_back(cpu);
+    }
+
+    for (auto node = 0u; node < node_cpus_.size(); ++node) {
+        for (auto cpu : node_cpus_[node]) {
+            if (cpu_nodes_.size() <= static_cast<size_t>(cpu))
+                cpu_nodes_.resize(cpu + 1, -1);
+            cpu_nodes_[cpu] = node;
+        }
+    }
+}
+
+int Topology::node_of_cpu(int cpu) const {
+    return cpu >= 0 && static_cast<size_t>(cpu) < cpu_nodes_.size() ? cpu_nodes_[cpu] : -1;
+}
+
+const std::vector<int>& Topology::cpus_of_node(int node) const {
+    return node >= 0 && static_cast<size_t>(node) < node_cpus_.size() ? node_cpus_[node] : c_no_cpus;
+}
+
+int Topology::current_node() const {
+    return node_of_cpu(sched_getcpu());
+}
+
+} // namespace griha
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <vector>
+
+namespace griha {
+
+// CPUs and NUMA nodes of the host as reported by sysfs;
+// host without NUMA information is seen as a single node 0
+class Topology {
+public:
+    Topology();
+
+    int node_of_cpu(int cpu) const; // -1 if cpu is unknown
+    const std::vector<int>& cpus_of_node(int node) const; // empty if node is unknown
+
+    // node of CPU the calling thread is running on
+    int current_node() const;
+
+private:
+    std::vector<int> cpu_nodes_; // indexed by cpu
+    std::vector<std::vector<int>> node_cpus_; // indexed by node
+};
+
+} // namespace griha
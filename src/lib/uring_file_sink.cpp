@@ -0,0 +1,330 @@
+#include "uring_file_sink.h"
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "bulk.h"
+#include "metrics.h"
+
+namespace griha {
+
+namespace {
+
+// every bulk takes three linked requests: open, write and close
+constexpr unsigned c_ring_entries = 256;
+constexpr unsigned c_requests_per_bulk = 3;
+constexpr unsigned c_max_files = c_ring_entries / c_requests_per_bulk;
+
+int sys_io_uring_setup(unsigned entries, io_uring_params* params) {
+    return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+}
+
+int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return static_cast<int>(::syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+}
+
+int sys_io_uring_register(int fd, unsigned opcode, const void* arg, unsigned nargs) {
+    return static_cast<int>(::syscall(__NR_io_uring_register, fd, opcode, arg, nargs));
+}
+
+template <typename T>
+T* ring_field(void* base, unsigned offset) {
+    return reinterpret_cast<T*>(static_cast<char*>(base) + offset);
+}
+
+// requests of bulk are told apart by low bits of their user data
+enum Operation : uintptr_t { open_file, write_file, close_file };
+constexpr uintptr_t c_operation_mask = 3;
+
+// bulk being written; it's alive until all its requests are completed.
+// Short write is continued by the next link reopening the file
+struct Request {
+    std::string filename;
+    std::string data;
+    size_t written {};
+    unsigned file_slot;
+    unsigned npending {};
+    bool failed { false };
+};
+static_assert(alignof(Request) > c_operation_mask);
+
+class Ring {
+public:
+    Ring() = default;
+    ~Ring();
+
+    Ring(const Ring&) = delete;
+    Ring& operator= (const Ring&) = delete;
+
+    bool init();
+
+    // takes ownership of request; returns false if ring is broken and the bulk is lost
+    bool submit(std::unique_ptr<Request> request);
+    void wait_all();
+
+    std::mutex guard; // contended only by flush of the whole sink
+    Counter nlost; // bulks which have failed after they were submitted
+
+private:
+    io_uring_sqe* next_sqe();
+    void submit_link(Request* req);
+    void complete(Request* req, Operation operation, int result);
+    void reap(unsigned min_complete);
+
+private:
+    int fd_ { -1 };
+    void* sq_ptr_ { MAP_FAILED };
+    size_t sq_size_ {};
+    void* cq_ptr_ { MAP_FAILED };
+    size_t cq_size_ {};
+    io_uring_sqe* sqes_ { static_cast<io_uring_sqe*>(MAP_FAILED) };
+    size_t sqes_size_ {};
+
+    unsigned* sq_tail_ {};
+    unsigned* sq_mask_ {};
+    unsigned* sq_array_ {};
+    unsigned* cq_head_ {};
+    unsigned* cq_tail_ {};
+    unsigned* cq_mask_ {};
+    io_uring_cqe* cqes_ {};
+
+    std::vector<unsigned> free_slots_;
+    size_t ninflight_ {};
+};
+
+Ring::~Ring() {
+    if (fd_ != -1) {
+        wait_all();
+        ::close(fd_);
+    }
+    if (sqes_ != MAP_FAILED)
+        ::munmap(sqes_, sqes_size_);
+    if (cq_ptr_ != MAP_FAILED && cq_ptr_ != sq_ptr_)
+        ::munmap(cq_ptr_, cq_size_);
+    if (sq_ptr_ != MAP_FAILED)
+        ::munmap(sq_ptr_, sq_size_);
+}
+
+bool Ring::init() {
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+
+    fd_ = sys_io_uring_setup(c_ring_entries, &params);
+    if (fd_ < 0) {
+        fd_ = -1;
+        return false;
+    }
+
+    sq_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    const auto single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap)
+        sq_size_ = cq_size_ = std::max(sq_size_, cq_size_);
+
+    sq_ptr_ = ::mmap(nullptr, sq_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQ_RING);
+    if (sq_ptr_ == MAP_FAILED)
+        return false;
+
+    cq_ptr_ = single_mmap
+        ? sq_ptr_
+        : ::mmap(nullptr, cq_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_CQ_RING);
+    if (cq_ptr_ == MAP_FAILED)
+        return false;
+
+    sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+    sqes_ = static_cast<io_uring_sqe*>(::mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES));
+    if (sqes_ == MAP_FAILED)
+        return false;
+
+    sq_tail_ = ring_field<unsigned>(sq_ptr_, params.sq_off.tail);
+    sq_mask_ = ring_field<unsigned>(sq_ptr_, params.sq_off.ring_mask);
+    sq_array_ = ring_field<unsigned>(sq_ptr_, params.sq_off.array);
+    cq_head_ = ring_field<unsigned>(cq_ptr_, params.cq_off.head);
+    cq_tail_ = ring_field<unsigned>(cq_ptr_, params.cq_off.tail);
+    cq_mask_ = ring_field<unsigned>(cq_ptr_, params.cq_off.ring_mask);
+    cqes_ = ring_field<io_uring_cqe>(cq_ptr_, params.cq_off.cqes);
+
+    // files are opened directly into sparse table of registered files,
+    // so write and close are able to refer to them within the same link
+    std::vector<int> files(c_max_files, -1);
+    if (sys_io_uring_register(fd_, IORING_REGISTER_FILES, files.data(), c_max_files) < 0)
+        return false;
+
+    for (auto i = c_max_files; i > 0; --i)
+        free_slots_.push_back(i - 1);
+    return true;
+}
+
+io_uring_sqe* Ring::next_sqe() {
+    const auto tail = *sq_tail_;
+    const auto index = tail & *sq_mask_;
+    auto sqe = &sqes_[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sq_array_[index] = index;
+    __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+    return sqe;
+}
+
+bool Ring::submit(std::unique_ptr<Request> request) {
+    // free slot means there is also space for its requests in submission queue;
+    // completion being waited for may be of request in the middle of a link
+    while (free_slots_.empty() && ninflight_ != 0)
+        reap(1);
+    if (free_slots_.empty())
+        return false;
+
+    request->file_slot = free_slots_.back();
+    free_slots_.pop_back();
+
+    ++ninflight_;
+    submit_link(request.release());
+
+    // completions are reaped without waiting to release memory of written bulks
+    reap(0);
+    return true;
+}
+
+void Ring::submit_link(Request* req) {
+    const auto user_data = reinterpret_cast<uintptr_t>(req);
+    req->npending = c_requests_per_bulk;
+
+    auto sqe = next_sqe();
+    sqe->opcode = IORING_OP_OPENAT;
+    sqe->flags = IOSQE_IO_LINK;
+    sqe->fd = AT_FDCWD;
+    sqe->addr = reinterpret_cast<uintptr_t>(req->filename.c_str());
+    sqe->len = 0644;
+    // O_CLOEXEC is meaningless and rejected for direct descriptors;
+    // file is truncated only by the first link of the bulk
+    sqe->open_flags = req->written == 0 ? O_WRONLY | O_CREAT | O_TRUNC : O_WRONLY;
+    sqe->file_index = req->file_slot + 1;
+    sqe->user_data = user_data | open_file;
+
+    sqe = next_sqe();
+    // hard link makes close to be executed even if write has failed
+    sqe->opcode = IORING_OP_WRITE;
+    sqe->flags = IOSQE_IO_HARDLINK | IOSQE_FIXED_FILE;
+    sqe->fd = static_cast<int>(req->file_slot);
+    sqe->addr = reinterpret_cast<uintptr_t>(req->data.data() + req->written);
+    sqe->len = static_cast<unsigned>(req->data.size() - req->written);
+    sqe->off = req->written;
+    sqe->user_data = user_data | write_file;
+
+    sqe = next_sqe();
+    sqe->opcode = IORING_OP_CLOSE;
+    sqe->file_index = req->file_slot + 1;
+    sqe->user_data = user_data | close_file;
+
+    while (sys_io_uring_enter(fd_, c_requests_per_bulk, 0, 0) < 0 && errno == EINTR) {}
+}
+
+void Ring::complete(Request* req, Operation operation, int result) {
+    // write is cancelled if open has failed; write making no progress would be repeated forever
+    if (operation == open_file && result < 0)
+        req->failed = true;
+    if (operation == write_file && result <= 0)
+        req->failed = true;
+    if (operation == write_file && result > 0)
+        req->written += static_cast<size_t>(result);
+
+    if (--req->npending != 0)
+        return;
+
+    // file is closed by the link, so the rest of data is written by the next one
+    if (!req->failed && req->written < req->data.size()) {
+        submit_link(req);
+        return;
+    }
+
+    if (req->failed)
+        ++nlost;
+    free_slots_.push_back(req->file_slot);
+    --ninflight_;
+    delete req;
+}
+
+void Ring::reap(unsigned min_complete) {
+    if (min_complete != 0 && ninflight_ != 0) {
+        while (sys_io_uring_enter(fd_, 0, min_complete, IORING_ENTER_GETEVENTS) < 0 && errno == EINTR) {}
+    }
+
+    auto head = *cq_head_;
+    const auto tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+    for (; head != tail; ++head) {
+        auto& cqe = cqes_[head & *cq_mask_];
+        const auto user_data = static_cast<uintptr_t>(cqe.user_data);
+        complete(reinterpret_cast<Request*>(user_data & ~c_operation_mask),
+            static_cast<Operation>(user_data & c_operation_mask), cqe.res);
+    }
+    __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+}
+
+void Ring::wait_all() {
+    while (ninflight_ != 0)
+        reap(1);
+}
+
+} // unnamed namespace
+
+struct UringFileSink::Impl {
+    std::vector<Ring> rings;
+
+    explicit Impl(size_t nthreads)
+        : rings(nthreads) {}
+};
+
+std::unique_ptr<UringFileSink> UringFileSink::create(size_t nthreads) {
+    auto priv = std::make_unique<Impl>(nthreads);
+    for (auto& ring : priv->rings)
+        if (!ring.init())
+            return nullptr;
+
+    return std::unique_ptr<UringFileSink> { new UringFileSink { std::move(priv) } };
+}
+
+UringFileSink::UringFileSink(std::unique_ptr<Impl> priv)
+    : priv_(std::move(priv)) {}
+
+UringFileSink::~UringFileSink() = default;
+
+size_t UringFileSink::write(std::string_view name, const Bulk& bulk, size_t index) {
+    auto request = std::make_unique<Request>();
+
+    // connection name and sequence number make file name unique and restore order of bulks
+    request->filename = "bulk_" + std::to_string(record::now_ns()) + '_' + std::string { name } + '_'
+        + std::to_string(bulk.seq) + ".log";
+
+    record::append_statements(request->data, bulk);
+    const auto nbytes = request->data.size();
+
+    auto& ring = priv_->rings[index];
+    std::lock_guard<std::mutex> l { ring.guard };
+    return ring.submit(std::move(request)) ? nbytes : c_lost;
+}
+
+void UringFileSink::flush() {
+    for (auto& ring : priv_->rings) {
+        std::lock_guard<std::mutex> l { ring.guard };
+        ring.wait_all();
+    }
+}
+
+uint64_t UringFileSink::nlost() const {
+    uint64_t ret = 0;
+    for (auto& ring : priv_->rings)
+        ret += ring.nlost.get();
+    return ret;
+}
+
+} // namespace griha
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <memory>
+#include <string_view>
+
+#include "file_sink.h"
+
+namespace griha {
+
+// Sink writing every bulk into its own file like file worker does by default,
+// but opening, writing and closing of files are submitted to io_uring as linked requests,
+// so executor threads don't wait for file system. Every executor thread has own ring
+class UringFileSink : public FileSink {
+
+    struct Impl;
+
+public:
+    // returns nullptr if io_uring isn't supported by the system
+    static std::unique_ptr<UringFileSink> create(size_t nthreads);
+
+    ~UringFileSink();
+
+    UringFileSink(const UringFileSink&) = delete;
+    UringFileSink& operator= (const UringFileSink&) = delete;
+
+    size_t write(std::string_view name, const Bulk& bulk, size_t index) override;
+
+    // waits for completion of all submitted requests
+    void flush() override;
+
+    uint64_t nlost() const override;
+
+private:
+    explicit UringFileSink(std::unique_ptr<Impl> priv);
+
+private:
+    std::unique_ptr<Impl> priv_;
+};
+
+} // namespace griha
@@ -0,0 +1,125 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <zstd.h>
+
+#include "segment_format.h"
+
+using namespace griha;
+
+namespace {
+
+void usage() {
+    std::cerr
+        << "usage: async_segdump <segment.seg>              print all records" << std::endl
+        << "       async_segdump -i <segment.idx>           print index" << std::endl
+        << "       async_segdump -r <n> <segment.seg>       print n-th record using index" << std::endl;
+}
+
+bool check_magic(std::istream& input, const char (&magic)[8]) {
+    char buffer[sizeof(magic)];
+    return input.read(buffer, sizeof(buffer)) && std::memcmp(buffer, magic, sizeof(magic)) == 0;
+}
+
+std::string index_name(std::string segment_name) {
+    const auto dot = segment_name.rfind(".seg");
+    if (dot != std::string::npos)
+        segment_name.erase(dot);
+    return segment_name + ".idx";
+}
+
+// reads and decompresses block starting at current position; returns false at end of segment
+bool read_block(std::istream& input, std::string& raw, std::string& compressed) {
+    segment::BlockHeader header;
+    if (!input.read(reinterpret_cast<char*>(&header), sizeof(header)))
+        return false;
+
+    compressed.resize(header.compressed_size);
+    raw.resize(header.raw_size);
+    if (!input.read(compressed.data(), compressed.size()))
+        throw std::runtime_error("truncated block");
+
+    const auto size = ZSTD_decompress(raw.data(), raw.size(), compressed.data(), compressed.size());
+    if (ZSTD_isError(size) || size != raw.size())
+        throw std::runtime_error(std::string { "corrupted block: " } + ZSTD_getErrorName(size));
+    return true;
+}
+
+int dump_segment(const std::string& name) {
+    std::ifstream input { name, std::ios::binary };
+    if (!check_magic(input, segment::c_segment_magic))
+        throw std::runtime_error(name + " isn't a segment file");
+
+    std::string raw, compressed;
+    while (read_block(input, raw, compressed))
+        std::cout << raw;
+    return 0;
+}
+
+std::vector<segment::IndexEntry> read_index(const std::string& name) {
+    std::ifstream input { name, std::ios::binary };
+    if (!check_magic(input, segment::c_index_magic))
+        throw std::runtime_error(name + " isn't an index file");
+
+    std::vector<segment::IndexEntry> ret;
+    segment::IndexEntry entry;
+    while (input.read(reinterpret_cast<char*>(&entry), sizeof(entry)))
+        ret.push_back(entry);
+    return ret;
+}
+
+int dump_index(const std::string& name) {
+    const auto entries = read_index(name);
+    std::cout << "#\tblock\toffset\tsize\ttime_ns\tseq" << std::endl;
+    for (auto i = 0u; i < entries.size(); ++i) {
+        auto& e = entries[i];
+        std::cout << i << '\t' << e.block_offset << '\t' << e.record_offset << '\t' << e.record_size
+            << '\t' << e.time_ns << '\t' << e.seq << std::endl;
+    }
+    return 0;
+}
+
+int dump_record(size_t n, const std::string& name) {
+    const auto entries = read_index(index_name(name));
+    if (n >= entries.size())
+        throw std::runtime_error("segment has " + std::to_string(entries.size()) + " records");
+
+    std::ifstream input { name, std::ios::binary };
+    if (!check_magic(input, segment::c_segment_magic))
+        throw std::runtime_error(name + " isn't a segment file");
+
+    // only the block holding the record is decompressed
+    auto& entry = entries[n];
+    input.seekg(entry.block_offset);
+    std::string raw, compressed;
+    if (!read_block(input, raw, compressed) || entry.record_offset + entry.record_size > raw.size())
+        throw std::runtime_error("index doesn't match segment");
+
+    std::cout.write(raw.data() + entry.record_offset, entry.record_size);
+    return 0;
+}
+
+} // unnamed namespace
+
+int main(int argc, char** argv) {
+    try {
+        if (argc == 2 && argv[1][0] != '-')
+            return dump_segment(argv[1]);
+        if (argc == 3 && std::strcmp(argv[1], "-i") == 0)
+            return dump_index(argv[2]);
+        if (argc == 4 && std::strcmp(argv[1], "-r") == 0)
+            return dump_record(std::strtoull(argv[2], nullptr, 10), argv[3]);
+    } catch (const std::exception& e) {
+        std::cerr << "async_segdump: " << e.what() << std::endl;
+        return 1;
+    }
+
+    usage();
+    return 2;
+}
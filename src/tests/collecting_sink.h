@@ -0,0 +1,73 @@
+#pragma once
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "async.h"
+
+namespace tests {
+
+// custom sink keeping statements of bulks it's fed with
+class CollectingSink {
+public:
+    using Bulk = std::vector<std::string>;
+
+    CollectingSink() {
+        sink_.write = &CollectingSink::write;
+        sink_.context = this;
+    }
+
+    CollectingSink(const CollectingSink&) = delete;
+    CollectingSink& operator= (const CollectingSink&) = delete;
+
+    // options of connection writing into this sink only
+    async::options_t options() const {
+        async::options_t ret;
+        ret.log = false;
+        ret.files = false;
+        ret.sinks = &sink_;
+        ret.nsinks = 1;
+        return ret;
+    }
+
+    std::vector<Bulk> bulks() const {
+        std::lock_guard l { guard_ };
+        return bulks_;
+    }
+
+    // returns false if fewer bulks have been written before timeout
+    bool wait_for(size_t nbulks, std::chrono::milliseconds timeout = std::chrono::seconds { 10 }) const {
+        const auto deadline = std::chrono::steady_clock::now() + timeout;
+        for (;;) {
+            {
+                std::lock_guard l { guard_ };
+                if (bulks_.size() >= nbulks)
+                    return true;
+            }
+            if (std::chrono::steady_clock::now() > deadline)
+                return false;
+            std::this_thread::sleep_for(std::chrono::milliseconds { 1 });
+        }
+    }
+
+private:
+    static void write(const async::bulk_t& bulk, std::size_t, void *context) {
+        Bulk statements;
+        for (auto i = 0u; i < bulk.count; ++i)
+            statements.emplace_back(static_cast<const char*>(bulk.statements[i].iov_base), bulk.statements[i].iov_len);
+
+        auto self = static_cast<CollectingSink*>(context);
+        std::lock_guard l { self->guard_ };
+        self->bulks_.push_back(std::move(statements));
+    }
+
+private:
+    async::sink_t sink_;
+    mutable std::mutex guard_;
+    std::vector<Bulk> bulks_;
+};
+
+} // namespace tests
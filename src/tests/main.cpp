@@ -0,0 +1,41 @@
+#define CATCH_CONFIG_RUNNER
+#include <catch2/catch.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include <dirent.h>
+#include <unistd.h>
+
+namespace {
+
+void remove_directory(const std::string& dir) {
+    if (auto d = opendir(dir.c_str())) {
+        while (auto e = readdir(d)) {
+            const std::string name = e->d_name;
+            if (name != "." && name != "..")
+                unlink((dir + '/' + name).c_str());
+        }
+        closedir(d);
+    }
+    rmdir(dir.c_str());
+}
+
+} // unnamed namespace
+
+// files of bulks are written into current directory, so tests run in a temporary one
+int main(int argc, char* argv[]) {
+    const char* tmp = std::getenv("TMPDIR");
+    std::string dir = std::string { tmp != nullptr ? tmp : "/tmp" } + "/async_tests_XXXXXX";
+    if (mkdtemp(dir.data()) == nullptr || chdir(dir.c_str()) != 0) {
+        std::perror("temporary directory of tests");
+        return EXIT_FAILURE;
+    }
+
+    const auto ret = Catch::Session().run(argc, argv);
+
+    // files which sinks write out on unloading of the library fail to be created
+    remove_directory(dir);
+    return ret;
+}
@@ -0,0 +1,46 @@
+#include <string>
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+#include "async.h"
+#include "collecting_sink.h"
+
+namespace {
+
+using Bulks = std::vector<tests::CollectingSink::Bulk>;
+
+Bulks interpret(size_t bulk_size, const std::string& data) {
+    tests::CollectingSink sink;
+    auto handle = async::connect(bulk_size, sink.options());
+    async::receive(handle, data.data(), data.size());
+    async::disconnect(handle);
+    return sink.bulks();
+}
+
+} // unnamed namespace
+
+TEST_CASE("start of explicit block closes dynamic bulk", "[blocks]") {
+    REQUIRE(interpret(3, "1\n2\n{\n3\n4\n}\n5\n") == Bulks { { "1", "2" }, { "3", "4" }, { "5" } });
+}
+
+TEST_CASE("explicit block isn't limited by bulk size", "[blocks]") {
+    REQUIRE(interpret(2, "{\n1\n2\n3\n4\n5\n}\n6\n7\n") == Bulks { { "1", "2", "3", "4", "5" }, { "6", "7" } });
+}
+
+TEST_CASE("nested blocks are part of outer block", "[blocks]") {
+    REQUIRE(interpret(2, "{\n1\n{\n2\n{\n3\n}\n4\n}\n5\n}\n6\n") == Bulks { { "1", "2", "3", "4", "5" }, { "6" } });
+    // empty blocks aren't published
+    REQUIRE(interpret(2, "{\n{\n}\n}\n1\n") == Bulks { { "1" } });
+}
+
+TEST_CASE("unclosed block isn't published at disconnect", "[blocks]") {
+    REQUIRE(interpret(2, "1\n{\n2\n3\n4\n") == Bulks { { "1" } });
+    // the outer block is still open
+    REQUIRE(interpret(2, "{\n1\n{\n2\n}\n3\n") == Bulks {});
+}
+
+TEST_CASE("end of block outside of block stops interpretation", "[blocks]") {
+    // dynamic bulk read before syntax error is lost as well
+    REQUIRE(interpret(2, "1\n2\n3\n}\n4\n5\n{\n6\n}\n") == Bulks { { "1", "2" } });
+}
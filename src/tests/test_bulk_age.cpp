@@ -0,0 +1,111 @@
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include <catch2/catch.hpp>
+
+#include "async.h"
+#include "collecting_sink.h"
+
+namespace {
+
+using Bulks = std::vector<tests::CollectingSink::Bulk>;
+
+// sink holding its pool thread until it's released, so its queue is filled up
+struct HeldSink {
+    std::atomic<bool> released { false };
+    std::atomic<size_t> nwritten {};
+
+    static void write(const async::bulk_t&, std::size_t, void *context) {
+        auto self = static_cast<HeldSink*>(context);
+        while (!self->released.load())
+            std::this_thread::sleep_for(std::chrono::microseconds { 100 });
+        ++self->nwritten;
+    }
+};
+
+// returns false if connection hasn't closed n bulks by age before timeout
+bool wait_for_flushed_by_age(async::handle_t handle, std::uint64_t n,
+                             std::chrono::milliseconds timeout = std::chrono::seconds { 10 }) {
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    async::metrics_t metrics;
+    while (async::get_metrics(handle, metrics) && metrics.flushed_by_age < n) {
+        if (std::chrono::steady_clock::now() > deadline)
+            return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds { 1 });
+    }
+    return metrics.flushed_by_age >= n;
+}
+
+} // unnamed namespace
+
+TEST_CASE("dynamic bulk is closed by age", "[bulk_age]") {
+    tests::CollectingSink sink;
+    auto options = sink.options();
+    options.max_bulk_age_ms = 20;
+
+    auto handle = async::connect(100, options);
+    async::receive(handle, "1\n2\n", 4);
+    REQUIRE(sink.wait_for(1));
+    REQUIRE(wait_for_flushed_by_age(handle, 1));
+
+    // the next bulk is aged on its own
+    async::receive(handle, "3\n", 2);
+    REQUIRE(sink.wait_for(2));
+    async::disconnect(handle);
+
+    REQUIRE(sink.bulks() == Bulks { { "1", "2" }, { "3" } });
+}
+
+TEST_CASE("explicit block isn't closed by age", "[bulk_age]") {
+    tests::CollectingSink sink;
+    auto options = sink.options();
+    options.max_bulk_age_ms = 5;
+
+    auto handle = async::connect(100, options);
+    async::receive(handle, "{\n1\n", 4);
+    std::this_thread::sleep_for(std::chrono::milliseconds { 50 });
+    REQUIRE(sink.bulks().empty());
+
+    async::receive(handle, "2\n}\n", 4);
+    REQUIRE(sink.wait_for(1));
+    async::disconnect(handle);
+
+    REQUIRE(sink.bulks() == Bulks { { "1", "2" } });
+}
+
+TEST_CASE("timer isn't blocked by full queue of a connection", "[bulk_age]") {
+    HeldSink held;
+    async::sink_t sink;
+    sink.write = &HeldSink::write;
+    sink.context = &held;
+    sink.queue_limit = 1;
+
+    async::options_t options;
+    options.log = false;
+    options.files = false;
+    options.sinks = &sink;
+    options.nsinks = 1;
+    options.max_bulk_age_ms = 5;
+
+    // the first bulk holds pool thread, the next ones fill the queue of two bulks, the last one finds no space
+    auto held_handle = async::connect(100, options);
+    for (auto i = 1; i <= 4; ++i) {
+        async::receive(held_handle, "1\n", 2);
+        REQUIRE(wait_for_flushed_by_age(held_handle, i));
+    }
+
+    // bulks of other connections are still closed by age
+    options.nsinks = 0;
+    auto handle = async::connect(100, options);
+    async::receive(handle, "1\n", 2);
+    const auto flushed = wait_for_flushed_by_age(handle, 1, std::chrono::seconds { 1 });
+
+    held.released = true;
+    async::disconnect(handle);
+    async::disconnect(held_handle);
+
+    REQUIRE(flushed);
+    // deferred bulk isn't lost
+    REQUIRE(held.nwritten == 4);
+}
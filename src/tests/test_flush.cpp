@@ -0,0 +1,124 @@
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <thread>
+
+#include <catch2/catch.hpp>
+
+#include "async.h"
+
+namespace {
+
+constexpr auto c_timeout = std::chrono::seconds { 10 };
+
+struct Disconnecting {
+    std::promise<void> done;
+};
+
+void disconnect_on_flushed(async::handle_t handle, void *context) {
+    async::disconnect(handle);
+    static_cast<Disconnecting*>(context)->done.set_value();
+}
+
+bool flush_and_disconnect(async::handle_t handle) {
+    Disconnecting disconnecting;
+    auto done = disconnecting.done.get_future();
+    REQUIRE(async::flush(handle, &disconnect_on_flushed, &disconnecting));
+    return done.wait_for(c_timeout) == std::future_status::ready;
+}
+
+// sink holding bulks of connection after the first one until it's released
+struct HeldSink {
+    std::atomic<bool> released { false };
+
+    static void write(const async::bulk_t& bulk, std::size_t, void *context) {
+        auto self = static_cast<HeldSink*>(context);
+        while (bulk.seq != 0 && !self->released.load())
+            std::this_thread::sleep_for(std::chrono::microseconds { 100 });
+    }
+};
+
+struct Releasing {
+    HeldSink sink;
+    std::atomic<bool> started { false };
+    std::promise<void> done;
+};
+
+void disconnect_and_release(async::handle_t handle, void *context) {
+    auto self = static_cast<Releasing*>(context);
+    self->started = true;
+    // producer fills the queue of held sink and waits for space in the meantime
+    std::this_thread::sleep_for(std::chrono::milliseconds { 50 });
+    async::disconnect(handle);
+    self->sink.released = true;
+    self->done.set_value();
+}
+
+} // unnamed namespace
+
+TEST_CASE("flush callback disconnects connection without pending bulks", "[flush]") {
+    async::options_t options;
+    options.log = false;
+    options.files = false;
+
+    // nothing to wait for, so callback is called by flush itself
+    auto handle = async::connect(3, options);
+    async::receive(handle, "1\n2\n3\n", 6);
+    REQUIRE(flush_and_disconnect(handle));
+
+    async::metrics_t metrics;
+    REQUIRE_FALSE(async::get_metrics(handle, metrics));
+}
+
+TEST_CASE("flush callback disconnects connection with pending bulks", "[flush]") {
+    async::options_t options;
+    options.log = false;
+    options.file_mode = async::file_mode_t::batched;
+
+    // callback is called by pool thread once bulks are handled
+    for (auto i = 0; i < 100; ++i) {
+        auto handle = async::connect(2, options);
+        async::receive(handle, "1\n2\n3\n4\n5\n", 10);
+        REQUIRE(flush_and_disconnect(handle));
+    }
+    async::flush_all();
+}
+
+TEST_CASE("flush_all waits for connections flushed at once", "[flush]") {
+    async::options_t options;
+    options.log = false;
+    options.files = false;
+
+    auto handle = async::connect(3, options);
+    async::flush_all();
+    async::disconnect(handle);
+}
+
+TEST_CASE("flush callback disconnects connection whose producer waits for it", "[flush]") {
+    Releasing releasing;
+    async::sink_t sink;
+    sink.write = &HeldSink::write;
+    sink.context = &releasing.sink;
+    sink.queue_limit = 1;
+
+    async::options_t options;
+    options.log = false;
+    options.files = false;
+    options.sinks = &sink;
+    options.nsinks = 1;
+
+    // disconnect by pool thread doesn't wait for producer blocked until the callback returns
+    auto handle = async::connect(1, options);
+    async::receive(handle, "0\n", 2);
+    auto done = releasing.done.get_future();
+    REQUIRE(async::flush(handle, &disconnect_and_release, &releasing));
+    while (!releasing.started.load())
+        std::this_thread::sleep_for(std::chrono::microseconds { 100 });
+    for (auto i = 0; i < 8; ++i)
+        async::receive(handle, "1\n", 2);
+    REQUIRE(done.wait_for(c_timeout) == std::future_status::ready);
+
+    async::flush_all();
+    async::metrics_t metrics;
+    REQUIRE_FALSE(async::get_metrics(handle, metrics));
+}
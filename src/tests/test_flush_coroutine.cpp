@@ -0,0 +1,50 @@
+#include <chrono>
+#include <exception>
+#include <future>
+
+#include <catch2/catch.hpp>
+
+#include "async.h"
+
+#ifdef ASYNC_HAS_COROUTINES
+
+namespace {
+
+// coroutine starting at once and destroyed when it's finished
+struct Detached {
+    struct promise_type {
+        Detached get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+Detached flush_and_disconnect(async::handle_t handle, std::promise<bool>& done) {
+    const auto flushed = co_await async::flushed(handle);
+    async::disconnect(handle);
+    done.set_value(flushed);
+}
+
+} // unnamed namespace
+
+TEST_CASE("coroutine disconnects connection after it's flushed", "[flush][coroutine]") {
+    async::options_t options;
+    options.log = false;
+    options.file_mode = async::file_mode_t::batched;
+
+    for (auto pending : { false, true }) {
+        options.files = pending;
+        auto handle = async::connect(2, options);
+        async::receive(handle, "1\n2\n3\n", 6);
+
+        std::promise<bool> done;
+        auto result = done.get_future();
+        flush_and_disconnect(handle, done);
+        REQUIRE(result.wait_for(std::chrono::seconds { 10 }) == std::future_status::ready);
+        REQUIRE(result.get());
+    }
+}
+
+#endif
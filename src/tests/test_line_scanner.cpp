@@ -0,0 +1,129 @@
+#include <cstdint>
+#include <random>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+#include "line_scanner.h"
+#include "line_scanner_impl.h"
+
+namespace {
+
+using griha::LineIndex;
+using griha::LineKind;
+using Marks = std::vector<std::pair<size_t, LineKind>>;
+using ScanLines = size_t (*)(const char*, size_t, uint32_t*);
+
+// lines split one by one as the vectorized kernels are expected to do it
+Marks reference(std::string_view data) {
+    Marks ret;
+    for (size_t begin = 0, end; (end = data.find('\n', begin)) != std::string_view::npos; begin = end + 1)
+        ret.emplace_back(end, griha::classify_line(data.substr(begin, end - begin)));
+    return ret;
+}
+
+Marks scan(ScanLines scan_lines, std::string_view data) {
+    std::vector<uint32_t> out(data.size());
+    out.resize(scan_lines(data.data(), data.size(), out.data()));
+
+    Marks ret;
+    for (auto value : out) {
+        const LineIndex::Mark mark { value };
+        ret.emplace_back(mark.end(), mark.kind());
+    }
+    return ret;
+}
+
+Marks scan(std::string_view data) {
+    LineIndex index;
+    index.scan(data);
+
+    Marks ret;
+    for (auto mark : index)
+        ret.emplace_back(mark.end(), mark.kind());
+    return ret;
+}
+
+// every kernel available on this CPU
+std::vector<ScanLines> kernels() {
+    std::vector<ScanLines> ret { &griha::details::scan_lines_baseline };
+#if defined(__x86_64__)
+    if (__builtin_cpu_supports("avx2"))
+        ret.push_back(&griha::details::scan_lines_avx2);
+#endif
+    return ret;
+}
+
+void check(std::string_view data) {
+    INFO("data of " << data.size() << " bytes");
+    const auto expected = reference(data);
+    REQUIRE(scan(data) == expected);
+    for (auto kernel : kernels())
+        REQUIRE(scan(kernel, data) == expected);
+}
+
+} // unnamed namespace
+
+TEST_CASE("line index splits lines crossing vector and block boundaries", "[line_scanner]") {
+    // newlines and delimiters are moved over 16-, 32- and 64-byte boundaries one byte at a time
+    for (auto shift = 0u; shift < 70; ++shift) {
+        std::string data(shift, 'a');
+        data += "\n{\n}\nstatement\n";
+        data += std::string(29, 'b') + "\n}\n";
+        check(data);
+    }
+}
+
+TEST_CASE("line index handles tail shorter than block", "[line_scanner]") {
+    for (auto size = 0u; size <= 130; ++size) {
+        std::string data;
+        for (auto i = 0u; i < size; ++i)
+            data += i % 7 == 6 ? '\n' : i % 7 == 5 ? '{' : 'x';
+        check(data);
+        // the last line isn't complete
+        check(data + "}");
+    }
+}
+
+TEST_CASE("line index tells delimiters from bytes colliding with them under mask", "[line_scanner]") {
+    // 'y' and DEL differ from braces only in bits masked out by the comparison
+    for (auto c : { 'y', '\x7f', '{', '}', '\xfb', '\xf9', ';', '[' }) {
+        const std::string line(1, c);
+        for (auto shift = 0u; shift < 66; ++shift) {
+            const auto data = std::string(shift, '\n') + line + "\n" + line + line + "\n";
+            check(data);
+        }
+    }
+
+    // last byte of block is a possible delimiter followed by newline in the next block
+    for (auto c : { 'y', '\x7f', '{', '}' }) {
+        check(std::string(63, '\n') + c + "\n");
+        check(std::string(31, '\n') + c + "\n");
+        check(std::string(15, '\n') + c + "\n");
+        check(std::string(62, 'a') + '\n' + c + "\n");
+    }
+
+    REQUIRE(scan("{\ny\n}\n\x7f\n") == Marks {
+        { 1, LineKind::block_begin }, { 3, LineKind::statement },
+        { 5, LineKind::block_end }, { 7, LineKind::statement } });
+}
+
+TEST_CASE("line index agrees with reference on random input", "[line_scanner]") {
+    const char c_alphabet[] = { '\n', '\n', '{', '}', 'y', '\x7f', 'a', ' ' };
+    std::mt19937 random { 27 };
+    std::uniform_int_distribution<size_t> size_of { 0, 300 };
+    std::uniform_int_distribution<size_t> byte_of { 0, sizeof(c_alphabet) - 1 };
+    std::uniform_int_distribution<size_t> offset_of { 0, 63 };
+
+    for (auto i = 0; i < 2000; ++i) {
+        // data doesn't start at aligned address
+        std::string buffer(offset_of(random), 'z');
+        const auto offset = buffer.size();
+        for (auto n = size_of(random); n != 0; --n)
+            buffer += c_alphabet[byte_of(random)];
+        check(std::string_view { buffer }.substr(offset));
+    }
+}
@@ -0,0 +1,169 @@
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+#include "async.h"
+#include "collecting_sink.h"
+
+namespace {
+
+using Bulk = tests::CollectingSink::Bulk;
+using Bulks = std::vector<Bulk>;
+
+// passes data to connection by parts of given size
+void receive_by(async::handle_t handle, const std::string& data, size_t part) {
+    for (size_t offset = 0; offset < data.size(); offset += part)
+        async::receive(handle, data.data() + offset, std::min(part, data.size() - offset));
+}
+
+} // unnamed namespace
+
+TEST_CASE("lines of receive call become statements", "[lines]") {
+    tests::CollectingSink sink;
+    auto handle = async::connect(2, sink.options());
+    async::receive(handle, "1\n2\n3\n4\n5\n", 10);
+    async::disconnect(handle);
+
+    REQUIRE(sink.bulks() == Bulks { { "1", "2" }, { "3", "4" }, { "5" } });
+}
+
+TEST_CASE("partial line is carried over to the next receive call", "[lines]") {
+    tests::CollectingSink sink;
+    auto handle = async::connect(3, sink.options());
+    async::receive(handle, "ab", 2);
+    async::receive(handle, "c\nd", 3);
+    async::receive(handle, "e\nf\n", 4);
+    async::disconnect(handle);
+
+    REQUIRE(sink.bulks() == Bulks { { "abc", "de", "f" } });
+}
+
+TEST_CASE("line spans many receive calls", "[lines]") {
+    const std::string line(100000, 'x');
+
+    for (auto part : { 1, 7, 4096, 65536 }) {
+        tests::CollectingSink sink;
+        auto handle = async::connect(2, sink.options());
+        receive_by(handle, "a\n" + line + "\nb\n", part);
+        async::disconnect(handle);
+
+        REQUIRE(sink.bulks() == Bulks { { "a", line }, { "b" } });
+    }
+}
+
+TEST_CASE("lines cross windows of line index of a single receive call", "[lines]") {
+    // lines of different lengths end around every multiple of 64 KiB
+    std::string data;
+    Bulk expected;
+    for (auto i = 0; data.size() < 300000; ++i) {
+        expected.push_back(std::string(i % 1000 + 1, static_cast<char>('a' + i % 26)));
+        data += expected.back() + '\n';
+    }
+
+    tests::CollectingSink sink;
+    auto handle = async::connect(expected.size(), sink.options());
+    async::receive(handle, data.data(), data.size());
+    async::disconnect(handle);
+
+    REQUIRE(sink.bulks() == Bulks { expected });
+}
+
+TEST_CASE("receive_many joins buffers of a connection", "[lines]") {
+    tests::CollectingSink first;
+    tests::CollectingSink second;
+    auto h1 = async::connect(10, first.options());
+    auto h2 = async::connect(10, second.options());
+
+    const async::handle_t handles[] = { h1, h1, h2, h1 };
+    const iovec buffers[] = {
+        { const_cast<char*>("1\n2"), 3 },
+        { const_cast<char*>("3\n"), 2 },
+        { const_cast<char*>("x\n"), 2 },
+        { const_cast<char*>("4\n"), 2 }
+    };
+    async::receive_many(handles, buffers, 4);
+    async::disconnect(h1);
+    async::disconnect(h2);
+
+    REQUIRE(first.bulks() == Bulks { { "1", "23", "4" } });
+    REQUIRE(second.bulks() == Bulks { { "x" } });
+}
+
+TEST_CASE("too long line is truncated or skipped", "[lines]") {
+    tests::CollectingSink sink;
+    auto options = sink.options();
+    options.max_line_length = 4;
+
+    SECTION("truncate") {
+        options.line_overflow = async::line_overflow_t::truncate;
+        auto handle = async::connect(10, options);
+        async::receive(handle, "123456\nab\n1234\n", 15);
+
+        async::metrics_t metrics;
+        REQUIRE(async::get_metrics(handle, metrics));
+        REQUIRE(metrics.overflowed_lines == 1);
+        async::disconnect(handle);
+
+        REQUIRE(sink.bulks() == Bulks { { "1234", "ab", "1234" } });
+    }
+
+    SECTION("skip") {
+        options.line_overflow = async::line_overflow_t::skip;
+        auto handle = async::connect(10, options);
+        async::receive(handle, "123456\nab\n1234\n", 15);
+
+        async::metrics_t metrics;
+        REQUIRE(async::get_metrics(handle, metrics));
+        REQUIRE(metrics.overflowed_lines == 1);
+        async::disconnect(handle);
+
+        REQUIRE(sink.bulks() == Bulks { { "ab", "1234" } });
+    }
+}
+
+TEST_CASE("too long line spanning several receive calls is truncated or skipped", "[lines]") {
+    const std::string data = "a\n" + std::string(10000, 'x') + "\nb\n";
+
+    for (auto part : { 1, 3, 4096 }) {
+        tests::CollectingSink truncating;
+        auto options = truncating.options();
+        options.max_line_length = 4;
+        auto handle = async::connect(10, options);
+        receive_by(handle, data, part);
+        async::disconnect(handle);
+        REQUIRE(truncating.bulks() == Bulks { { "a", "xxxx", "b" } });
+
+        tests::CollectingSink skipping;
+        options = skipping.options();
+        options.max_line_length = 4;
+        options.line_overflow = async::line_overflow_t::skip;
+        handle = async::connect(10, options);
+        receive_by(handle, data, part);
+        async::disconnect(handle);
+        REQUIRE(skipping.bulks() == Bulks { { "a", "b" } });
+    }
+}
+
+TEST_CASE("truncated line may become block delimiter", "[lines]") {
+    tests::CollectingSink sink;
+    auto options = sink.options();
+    options.max_line_length = 1;
+    auto handle = async::connect(10, options);
+    async::receive(handle, "a\n{{\n1\n}}\nb\n", 12);
+    async::disconnect(handle);
+
+    REQUIRE(sink.bulks() == Bulks { { "a" }, { "1" }, { "b" } });
+}
+
+TEST_CASE("line of several megabytes isn't limited by default", "[lines]") {
+    const std::string line(3 * 1024 * 1024, 'x');
+
+    tests::CollectingSink sink;
+    auto handle = async::connect(1, sink.options());
+    receive_by(handle, line + '\n', 100000);
+    async::disconnect(handle);
+
+    REQUIRE(sink.bulks() == Bulks { { line } });
+}
@@ -0,0 +1,133 @@
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+#include "logger.h"
+
+namespace {
+
+constexpr auto c_timeout = std::chrono::seconds { 10 };
+
+// output written by writer thread of logger and read by test
+class SharedOutput : public std::streambuf {
+public:
+    std::string text() const {
+        std::lock_guard l { guard_ };
+        return text_;
+    }
+
+    size_t nlines() const {
+        std::lock_guard l { guard_ };
+        return std::count(text_.begin(), text_.end(), '\n');
+    }
+
+    // returns false on timeout
+    bool wait_for_lines(size_t n) const {
+        const auto deadline = std::chrono::steady_clock::now() + c_timeout;
+        while (nlines() < n) {
+            if (std::chrono::steady_clock::now() > deadline)
+                return false;
+            std::this_thread::sleep_for(std::chrono::milliseconds { 1 });
+        }
+        return true;
+    }
+
+protected:
+    int_type overflow(int_type c) override {
+        if (c != traits_type::eof()) {
+            std::lock_guard l { guard_ };
+            text_.push_back(traits_type::to_char_type(c));
+        }
+        return c;
+    }
+
+    std::streamsize xsputn(const char* s, std::streamsize n) override {
+        std::lock_guard l { guard_ };
+        text_.append(s, n);
+        return n;
+    }
+
+private:
+    mutable std::mutex guard_;
+    std::string text_;
+};
+
+} // unnamed namespace
+
+TEST_CASE("async logger writes out buffer reaching flush_bytes before flush_interval", "[logger]") {
+    SharedOutput output;
+    std::ostream os { &output };
+
+    griha::Logger::AsyncOptions options;
+    options.flush_interval = std::chrono::hours { 1 };
+    options.flush_bytes = 16;
+    griha::Logger logger { os, options };
+
+    logger.log("first message");
+    REQUIRE(output.nlines() == 0);
+    logger.log("second message");
+    REQUIRE(output.wait_for_lines(2));
+    REQUIRE(output.text() == "first message\nsecond message\n");
+
+    // writer is woken again by the next overflow
+    logger.log("third message");
+    logger.log("fourth message");
+    REQUIRE(output.wait_for_lines(4));
+}
+
+TEST_CASE("async logger keeps order of messages of several threads", "[logger]") {
+    SharedOutput output;
+    std::ostream os { &output };
+
+    griha::Logger::AsyncOptions options;
+    options.flush_bytes = 64;
+    griha::Logger logger { os, options };
+
+    constexpr auto c_nthreads = 4;
+    constexpr auto c_nmessages = 1000;
+    std::vector<std::thread> threads;
+    for (auto i = 0; i < c_nthreads; ++i)
+        threads.emplace_back([&logger, i] {
+            for (auto n = 0; n < c_nmessages; ++n)
+                logger.log(std::to_string(i) + ':' + std::to_string(n));
+        });
+    for (auto& thread : threads)
+        thread.join();
+    logger.flush();
+
+    REQUIRE(output.nlines() == c_nthreads * c_nmessages);
+
+    // messages of a thread follow each other in order of calls
+    std::vector<int> next(c_nthreads);
+    std::istringstream is { output.text() };
+    for (std::string line; std::getline(is, line);) {
+        const auto colon = line.find(':');
+        const auto thread = std::stoi(line.substr(0, colon));
+        REQUIRE(std::stoi(line.substr(colon + 1)) == next[thread]++);
+    }
+}
+
+TEST_CASE("async logger writes out messages of exited threads", "[logger]") {
+    SharedOutput output;
+    std::ostream os { &output };
+
+    griha::Logger::AsyncOptions options;
+    options.flush_interval = std::chrono::milliseconds { 1 };
+    griha::Logger logger { os, options };
+
+    // buffers of exited threads are released while others are logging
+    constexpr auto c_nthreads = 200;
+    for (auto i = 0; i < c_nthreads; ++i)
+        std::thread { [&logger, i] { logger.log(std::to_string(i)); } }.join();
+    logger.flush();
+
+    REQUIRE(output.nlines() == c_nthreads);
+}
@@ -0,0 +1,91 @@
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+#include "statement_container.h"
+#include "statement_factory.h"
+
+namespace {
+
+using griha::StatementFactory;
+
+std::string_view text(const griha::Statement& stm) {
+    return std::get<griha::SomeStatement>(stm).value();
+}
+
+// creates statements of lines in a block of their own
+griha::StatementContainer create(StatementFactory& factory, const std::vector<std::string>& lines) {
+    griha::StatementContainer ret;
+    for (auto& line : lines)
+        ret.push_back(factory.create(line, ret));
+    return ret;
+}
+
+StatementFactory::Options cache_of(size_t capacity, StatementFactory::Eviction eviction) {
+    StatementFactory::Options ret;
+    ret.capacity = capacity;
+    ret.eviction = eviction;
+    return ret;
+}
+
+} // unnamed namespace
+
+TEST_CASE("repeated statements are found in cache", "[statement_factory]") {
+    StatementFactory factory { cache_of(4, StatementFactory::Eviction::generations) };
+    const auto block = create(factory, { "a", "b", "a", "a", "b" });
+
+    REQUIRE(factory.nhits() == 3);
+    REQUIRE(factory.nmisses() == 2);
+    // interned text is stored once
+    REQUIRE(text(*block.begin()).data() == text(*(block.begin() + 2)).data());
+}
+
+TEST_CASE("statements of older generation survive eviction once they are met again", "[statement_factory]") {
+    SECTION("generations") {
+        StatementFactory factory { cache_of(2, StatementFactory::Eviction::generations) };
+        // "c" evicts generation of "a" and "b", but "a" is still found there and moved into the new one
+        create(factory, { "a", "b", "c", "a" });
+        REQUIRE(factory.nhits() == 1);
+        REQUIRE(factory.nmisses() == 3);
+
+        // "d" evicts generation of "c" and "a", so "b" met only once is dropped while "a" is kept
+        create(factory, { "d", "a", "b" });
+        REQUIRE(factory.nhits() == 1 + 1);
+        REQUIRE(factory.nmisses() == 3 + 2);
+    }
+
+    SECTION("clear") {
+        StatementFactory factory { cache_of(2, StatementFactory::Eviction::clear) };
+        create(factory, { "a", "b", "c", "a" });
+        REQUIRE(factory.nhits() == 0);
+        REQUIRE(factory.nmisses() == 4);
+    }
+}
+
+TEST_CASE("block keeps evicted generations alive", "[statement_factory]") {
+    for (auto eviction : { StatementFactory::Eviction::generations, StatementFactory::Eviction::clear }) {
+        StatementFactory factory { cache_of(2, eviction) };
+        const auto block = create(factory, { "first", "second", "third", "fourth", "fifth" });
+
+        // many generations are dropped by cache after the block has been created
+        for (auto i = 0; i < 100; ++i)
+            create(factory, { std::to_string(i) });
+
+        std::vector<std::string_view> texts;
+        for (auto& stm : block)
+            texts.push_back(text(stm));
+        REQUIRE(texts == std::vector<std::string_view> { "first", "second", "third", "fourth", "fifth" });
+    }
+}
+
+TEST_CASE("long and empty statements bypass cache", "[statement_factory]") {
+    auto options = cache_of(4, StatementFactory::Eviction::generations);
+    options.max_length = 3;
+    StatementFactory factory { options };
+    create(factory, { "long", "long", "", "" });
+
+    REQUIRE(factory.nhits() == 0);
+    REQUIRE(factory.nmisses() == 0);
+}
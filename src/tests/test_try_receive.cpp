@@ -0,0 +1,112 @@
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include <catch2/catch.hpp>
+
+#include "async.h"
+
+namespace {
+
+// sink holding its pool thread until it's released, so its queue is filled up
+struct BlockingSink {
+    std::atomic<bool> released { false };
+    std::atomic<size_t> nwritten {};
+
+    static void write(const async::bulk_t&, std::size_t, void *context) {
+        auto self = static_cast<BlockingSink*>(context);
+        while (!self->released.load())
+            std::this_thread::sleep_for(std::chrono::microseconds { 100 });
+        ++self->nwritten;
+    }
+};
+
+async::options_t sink_options(const async::sink_t& sink) {
+    async::options_t options;
+    options.log = false;
+    options.files = false;
+    options.sinks = &sink;
+    options.nsinks = 1;
+    return options;
+}
+
+async::result_t overflow_sink(async::queue_overflow_t overflow) {
+    BlockingSink blocking;
+    async::sink_t sink;
+    sink.write = &BlockingSink::write;
+    sink.context = &blocking;
+    sink.queue_limit = 1;
+    sink.queue_overflow = overflow;
+
+    auto options = sink_options(sink);
+    options.queue_overflow = async::queue_overflow_t::error;
+
+    auto handle = async::connect(1, options);
+    auto ret = async::result_t::ok;
+    for (auto i = 0; i < 16 && ret == async::result_t::ok; ++i)
+        ret = async::try_receive(handle, "1\n2\n3\n4\n", 8);
+
+    blocking.released = true;
+    async::disconnect(handle);
+    return ret;
+}
+
+} // unnamed namespace
+
+TEST_CASE("try_receive reports queue_full only for sinks of error policy", "[try_receive]") {
+    REQUIRE(overflow_sink(async::queue_overflow_t::drop) == async::result_t::ok);
+    REQUIRE(overflow_sink(async::queue_overflow_t::error) == async::result_t::queue_full);
+}
+
+TEST_CASE("drop policy counts bulks not fitting into the queue", "[overflow]") {
+    BlockingSink blocking;
+    async::sink_t sink;
+    sink.write = &BlockingSink::write;
+    sink.context = &blocking;
+    sink.queue_limit = 2;
+    sink.queue_overflow = async::queue_overflow_t::drop;
+
+    // receive never waits for held sink
+    auto handle = async::connect(1, sink_options(sink));
+    for (auto i = 0; i < 16; ++i)
+        async::receive(handle, "1\n", 2);
+
+    async::metrics_t metrics;
+    REQUIRE(async::get_metrics(handle, metrics));
+    blocking.released = true;
+    async::disconnect(handle);
+
+    // one bulk is held by the sink, two of them are queued
+    REQUIRE(metrics.sinks[0].dropped_blocks >= 16 - 3);
+    REQUIRE(metrics.sinks[0].max_queue_depth == 2);
+    REQUIRE(blocking.nwritten + metrics.sinks[0].dropped_blocks == 16);
+}
+
+TEST_CASE("block policy waits for space in the queue and loses nothing", "[overflow]") {
+    BlockingSink blocking;
+    async::sink_t sink;
+    sink.write = &BlockingSink::write;
+    sink.context = &blocking;
+    sink.queue_limit = 2;
+
+    auto handle = async::connect(1, sink_options(sink));
+    std::thread releasing { [&blocking] {
+        std::this_thread::sleep_for(std::chrono::milliseconds { 50 });
+        blocking.released = true;
+    } };
+
+    // producer is blocked until the sink is released
+    const auto started = std::chrono::steady_clock::now();
+    for (auto i = 0; i < 16; ++i)
+        async::receive(handle, "1\n", 2);
+    const auto blocked = std::chrono::steady_clock::now() - started;
+    releasing.join();
+
+    async::metrics_t metrics;
+    REQUIRE(async::get_metrics(handle, metrics));
+    async::disconnect(handle);
+
+    REQUIRE(blocked >= std::chrono::milliseconds { 40 });
+    REQUIRE(metrics.sinks[0].dropped_blocks == 0);
+    REQUIRE(blocking.nwritten == 16);
+}